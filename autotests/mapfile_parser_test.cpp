@@ -0,0 +1,245 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mapfile_parser.h"
+#include "mapfile_writer.h"
+#include "rescue_totals.h"
+
+#include <QBuffer>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <cstring>
+#include <random>
+
+class MapfileParserTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parseFixture();
+    void parseParallel();
+    void reparse();
+    void toInteger_data();
+    void toInteger();
+    void toIntegerAsQString();
+};
+
+namespace {
+
+QByteArray toByteArray(const BlockTable &blocks, const RescueStatus &status)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    MapfileWriter writer;
+    writer.setRescueStatus(status);
+    writer.write(blocks, &buffer);
+    return buffer.data();
+}
+
+/* contiguous blocks of random sizes and statuses */
+BlockTable randomBlocks(int count, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> sectors(1, 4096);
+    std::uniform_int_distribution<int> status(0, BlockStatus::Recovered);
+    BlockTable blocks;
+    qint64 position = 0;
+    for (int i = 0; i < count; ++i) {
+        const qint64 size = 512 * qint64(sectors(random));
+        blocks.append(position, size, BlockStatus::Code(status(random)));
+        position += size;
+    }
+    return blocks;
+}
+
+}
+
+/*
+ * A mapfile of GNU ddrescue 1.22, with its comments, status line and 209 blocks
+ */
+void MapfileParserTest::parseFixture()
+{
+    MapfileParser parser;
+    QVERIFY2(parser.parseFile(QStringLiteral(KDDRESCUEVIEW_TESTS_DIR "/Seagate1.mapfile")), qPrintable(parser.errorString()));
+
+    const RescueStatus status = parser.rescueStatus();
+    QCOMPARE(status.currentPosition().data(), Q_INT64_C(0x1D34BAAE000));
+    QCOMPARE(status.currentOperation().data(), QStringLiteral("+"));
+    QCOMPARE(status.currentPass(), 3);
+
+    const BlockTable &blocks = parser.blocks();
+    QCOMPARE(blocks.count(), 209);
+    QCOMPARE(blocks.domainStart(), Q_INT64_C(0));
+    QCOMPARE(blocks.domainFinish(), Q_INT64_C(0x2BAA1476000));
+    QCOMPARE(blocks.size(0).data(), Q_INT64_C(0x1D337487000));
+    QCOMPARE(blocks.status(0), BlockStatus::Recovered);
+    QCOMPARE(blocks.position(1).data(), Q_INT64_C(0x1D337487000));
+    QCOMPARE(blocks.status(1), BlockStatus::BadSector);
+    QCOMPARE(blocks.position(208).data(), Q_INT64_C(0x1D34BAAF000));
+    QCOMPARE(blocks.size(208).data(), Q_INT64_C(0xE7559C7000));
+
+    const RescueTotals totals(blocks);
+    QCOMPARE(totals.recovered().data(), Q_INT64_C(3000591458304));
+    QCOMPARE(totals.badsectors().data(), Q_INT64_C(1523712));
+    QCOMPARE(totals.nontried().data(), Q_INT64_C(0));
+}
+
+/*
+ * The chunks parsed concurrently make the same table as a single thread
+ */
+void MapfileParserTest::parseParallel()
+{
+    RescueStatus status;
+    status.setCurrentPosition(0x1000);
+    status.setCurrentOperation(QStringLiteral("*"));
+    status.setCurrentPass(2);
+    const BlockTable blocks = randomBlocks(200000, 1);
+    const QByteArray mapfile = toByteArray(blocks, status);
+
+    MapfileParser parallel;
+    QVERIFY(parallel.parse(mapfile.constData(), mapfile.constData() + mapfile.size()));
+    MapfileParser single;
+    single.setParallel(false);
+    QVERIFY(single.parse(mapfile.constData(), mapfile.constData() + mapfile.size()));
+
+    for (const MapfileParser *parser : { &parallel, &single }) {
+        QCOMPARE(parser->blocks().count(), blocks.count());
+        QVERIFY(memcmp(parser->blocks().starts(), blocks.starts(), sizeof(qint64) * (blocks.count() + 1)) == 0);
+        QVERIFY(memcmp(parser->blocks().statuses(), blocks.statuses(), blocks.count()) == 0);
+        QCOMPARE(parser->rescueStatus().currentPosition().data(), Q_INT64_C(0x1000));
+        QCOMPARE(parser->rescueStatus().currentPass(), 2);
+    }
+}
+
+/*
+ * A parse given the previous one, after ddrescue changed a few blocks, makes the same
+ * table and line count as a full parse
+ */
+void MapfileParserTest::reparse()
+{
+    RescueStatus status;
+    status.setCurrentPosition(0x1000);
+    QByteArray mapfile = toByteArray(randomBlocks(200000, 2), status);
+    MapfileParser previous;
+    previous.setIncremental(true);
+    QVERIFY(previous.parse(mapfile.constData(), mapfile.constData() + mapfile.size()));
+
+    std::mt19937 random(2);
+    for (int refresh = 0; refresh < 20; ++refresh) {
+        // the status of a block line past the status line, as a rescue in progress changes it
+        const int line = mapfile.indexOf('\n', mapfile.size() / 2 + int(random() % (mapfile.size() / 2))) + 1;
+        const int newline = mapfile.indexOf('\n', line);
+        if (line > 0 && newline > line) {
+            mapfile[newline - 1] = (mapfile.at(newline - 1) == '+') ? '-' : '+';
+        }
+
+        MapfileParser full;
+        QVERIFY(full.parse(mapfile.constData(), mapfile.constData() + mapfile.size()));
+        MapfileParser parser;
+        parser.setIncremental(true);
+        QVERIFY(parser.parse(mapfile.constData(), mapfile.constData() + mapfile.size(), &previous));
+        QCOMPARE(parser.lineCount(), full.lineCount());
+        QCOMPARE(parser.blocks().count(), full.blocks().count());
+        QVERIFY(memcmp(parser.blocks().starts(), full.blocks().starts(), sizeof(qint64) * (full.blocks().count() + 1)) == 0);
+        QVERIFY(memcmp(parser.blocks().statuses(), full.blocks().statuses(), full.blocks().count()) == 0);
+        // the reused lines count as parsed, once
+        QCOMPARE(parser.bytesParsed(), full.bytesParsed());
+        QCOMPARE(parser.blocksFound(), full.blocksFound());
+        previous = parser;
+    }
+}
+
+void MapfileParserTest::toInteger_data()
+{
+    QTest::addColumn<QByteArray>("text");
+    QTest::addColumn<int>("base");
+    QTest::addColumn<bool>("ok");
+    QTest::addColumn<qint64>("value");
+
+    QTest::newRow("decimal") << QByteArray("1234567") << 0 << true << Q_INT64_C(1234567);
+    QTest::newRow("zero") << QByteArray("0") << 0 << true << Q_INT64_C(0);
+    QTest::newRow("hexadecimal") << QByteArray("0x1D34BAAE000") << 0 << true << Q_INT64_C(0x1D34BAAE000);
+    QTest::newRow("lowercase") << QByteArray("0xabcdef") << 0 << true << Q_INT64_C(0xabcdef);
+    QTest::newRow("uppercase prefix") << QByteArray("0XFF") << 0 << true << Q_INT64_C(255);
+    QTest::newRow("octal") << QByteArray("0777") << 0 << true << Q_INT64_C(0777);
+    QTest::newRow("plus sign") << QByteArray("+42") << 0 << true << Q_INT64_C(42);
+    QTest::newRow("largest") << QByteArray("0x7FFFFFFFFFFFFFFF") << 0 << true << Q_INT64_C(0x7FFFFFFFFFFFFFFF);
+    QTest::newRow("overflow") << QByteArray("0x8000000000000000") << 0 << false << Q_INT64_C(0);
+    QTest::newRow("decimal overflow") << QByteArray("9223372036854775808") << 0 << false << Q_INT64_C(0);
+    QTest::newRow("empty") << QByteArray("") << 0 << false << Q_INT64_C(0);
+    QTest::newRow("prefix only") << QByteArray("0x") << 0 << false << Q_INT64_C(0);
+    QTest::newRow("sign only") << QByteArray("+") << 0 << false << Q_INT64_C(0);
+    QTest::newRow("negative") << QByteArray("-1") << 0 << false << Q_INT64_C(0);
+    QTest::newRow("octal digit") << QByteArray("08") << 0 << false << Q_INT64_C(0);
+    QTest::newRow("hexadecimal digit in decimal") << QByteArray("12a") << 0 << false << Q_INT64_C(0);
+    QTest::newRow("garbage") << QByteArray("0x12g") << 0 << false << Q_INT64_C(0);
+    QTest::newRow("pass in base 10") << QByteArray("010") << 10 << true << Q_INT64_C(10);
+    QTest::newRow("no prefix in base 10") << QByteArray("0x10") << 10 << false << Q_INT64_C(0);
+}
+
+void MapfileParserTest::toInteger()
+{
+    QFETCH(QByteArray, text);
+    QFETCH(int, base);
+    QFETCH(bool, ok);
+    QFETCH(qint64, value);
+
+    qint64 result = 0;
+    QCOMPARE(MapfileParser::toInteger(text.constData(), text.constData() + text.size(), base, &result), ok);
+    if (ok) {
+        QCOMPARE(result, value);
+    }
+}
+
+/*
+ * The tokenizer replaced QString::toLongLong(&ok, 0): it must agree with it on any
+ * unsigned token
+ */
+void MapfileParserTest::toIntegerAsQString()
+{
+    static const char prefixes[][3] = { "", "0", "0x", "0X" };
+    static const char digits[] = "0123456789abcdefABCDEFgx";
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> prefix(0, 3);
+    std::uniform_int_distribution<int> digit(0, int(sizeof(digits)) - 2);
+    std::uniform_int_distribution<int> length(0, 20);
+    for (int i = 0; i < 100000; ++i) {
+        QByteArray text = (random() % 8 == 0) ? QByteArray("+") : QByteArray();
+        text += prefixes[prefix(random)];
+        for (int n = length(random); n > 0; --n) {
+            text += digits[digit(random)];
+        }
+
+        bool expected_ok = false;
+        const qint64 expected = QString::fromLatin1(text).toLongLong(&expected_ok, 0);
+        qint64 result = 0;
+        const bool ok = MapfileParser::toInteger(text.constData(), text.constData() + text.size(), 0, &result);
+        QVERIFY2(ok == expected_ok, text.constData());
+        if (ok) {
+            QVERIFY2(result == expected, text.constData());
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(MapfileParserTest)
+
+#include "mapfile_parser_test.moc"
@@ -0,0 +1,98 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "square_color.h"
+#include "square_palette.h"
+
+#include <QTest>
+#include <QVector>
+
+#include <random>
+
+Q_DECLARE_METATYPE(SquarePalette::Kernel)
+
+class SquarePaletteTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void palette();
+    void toPixels_data();
+    void toPixels();
+};
+
+/*
+ * The lookup table gives the colors of SquareColor, the bits above the 6 statuses
+ * being ignored
+ */
+void SquarePaletteTest::palette()
+{
+    for (int mask = 0; mask < 256; ++mask) {
+        QCOMPARE(SquarePalette::pixel(quint8(mask)), SquareColor(quint8(mask % SquarePalette::mask_count)).rgba());
+    }
+}
+
+void SquarePaletteTest::toPixels_data()
+{
+    QTest::addColumn<SquarePalette::Kernel>("kernel");
+
+    QTest::newRow("scalar") << SquarePalette::Scalar;
+    QTest::newRow("sse4.1") << SquarePalette::Sse41;
+    QTest::newRow("avx2") << SquarePalette::Avx2;
+}
+
+/*
+ * Each loop gives the pixels of SquareColor on random masks, at any count and
+ * alignment: the vector loops leave the last squares to the scalar one
+ */
+void SquarePaletteTest::toPixels()
+{
+    QFETCH(SquarePalette::Kernel, kernel);
+    if (!SquarePalette::isSupported(kernel)) {
+        QSKIP("not supported by this processor");
+    }
+
+    std::mt19937 random(1);
+    const int max_count = 1000;
+    QVector<quint8> masks(max_count + 32);
+    QVector<QRgb> pixels(max_count + 32);
+    for (int count = 0; count <= max_count; count += 1 + count / 8) {
+        for (int offset = 0; offset < 32; offset += 7) {
+            for (quint8 &mask : masks) {
+                mask = quint8(random());
+            }
+            pixels.fill(0);
+            SquarePalette::toPixels(masks.constData() + offset, pixels.data() + offset, count, kernel);
+            for (int i = 0; i < pixels.count(); ++i) {
+                const bool converted = i >= offset && i < offset + count;
+                const QRgb expected = converted ? SquareColor(quint8(masks.at(i) % SquarePalette::mask_count)).rgba() : 0;
+                if (pixels.at(i) != expected) {
+                    QFAIL(qPrintable(QStringLiteral("count %1, offset %2: pixel %3 is %4 instead of %5")
+                                     .arg(count).arg(offset).arg(i).arg(pixels.at(i), 8, 16).arg(expected, 8, 16)));
+                }
+            }
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(SquarePaletteTest)
+
+#include "square_palette_test.moc"
@@ -0,0 +1,134 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench_maps.h"
+#include "mapfile_writer.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <limits>
+#include <random>
+
+namespace {
+
+/*
+ * Mostly recovered blocks with the other statuses in between, the sizes in sectors,
+ * as in a mapfile of a rescue in progress
+ */
+class SyntheticBlocks
+{
+public:
+    explicit SyntheticBlocks(unsigned seed)
+        : m_random(seed)
+        , m_sectors(1, 4096)
+        , m_status(0, int(sizeof(statuses) / sizeof(statuses[0])) - 1)
+    {
+    }
+
+    qint64 nextSize() { return 512 * qint64(m_sectors(m_random)); }
+    BlockStatus::Code nextStatus() { return statuses[m_status(m_random)]; }
+
+private:
+    static const BlockStatus::Code statuses[8];
+
+    std::mt19937 m_random;
+    std::uniform_int_distribution<int> m_sectors;
+    std::uniform_int_distribution<int> m_status;
+};
+
+const BlockStatus::Code SyntheticBlocks::statuses[8] = {
+    BlockStatus::Recovered, BlockStatus::NonTried, BlockStatus::Recovered, BlockStatus::NonTrimmed,
+    BlockStatus::Recovered, BlockStatus::NonScraped, BlockStatus::Recovered, BlockStatus::BadSector,
+};
+
+}
+
+bool writeSyntheticMapfile(const QString &file_name, int line_count, unsigned seed)
+{
+    QFile file(file_name);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    RescueStatus rescue_status;
+    rescue_status.setCurrentPosition(0);
+    rescue_status.setCurrentOperation(QStringLiteral("?"));
+    rescue_status.setCurrentPass(1);
+    MapfileWriter writer;
+    writer.setRescueStatus(rescue_status);
+    writer.setComments({ QStringLiteral(" Synthetic mapfile of kddrescueview-bench") });
+    writer.begin(&file);
+    SyntheticBlocks blocks(seed);
+    qint64 position = 0;
+    for (int line = 0; line < line_count; ++line) {
+        const qint64 size = blocks.nextSize();
+        if (!writer.append(position, size, blocks.nextStatus())) {
+            break;
+        }
+        position += size;
+    }
+    return writer.finish();
+}
+
+BlockTable syntheticBlocks(int count, unsigned seed)
+{
+    SyntheticBlocks blocks(seed);
+    BlockTable table;
+    qint64 position = 0;
+    for (int i = 0; i < count; ++i) {
+        const qint64 size = blocks.nextSize();
+        table.append(position, size, blocks.nextStatus());
+        position += size;
+    }
+    return table;
+}
+
+QString fixtureMapfile()
+{
+    return QStringLiteral(KDDRESCUEVIEW_TESTS_DIR "/Seagate1.mapfile");
+}
+
+qint64 bestTime(int repeat, const std::function<void()> &run)
+{
+    qint64 best = std::numeric_limits<qint64>::max();
+    for (int i = 0; i < repeat; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        run();
+        best = qMin(best, timer.nsecsElapsed());
+    }
+    return best;
+}
+
+bool toCounts(const QString &text, QList<int> *counts)
+{
+    counts->clear();
+    const QStringList items = text.split(QLatin1Char(','));
+    for (const QString &item : items) {
+        bool ok = false;
+        const int count = item.toInt(&ok);
+        if (!ok || count <= 0) {
+            return false;
+        }
+        counts->append(count);
+    }
+    return !counts->isEmpty();
+}
@@ -0,0 +1,46 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCH_MAPS_H
+#define BENCH_MAPS_H
+
+#include "block_table.h"
+
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+
+// a mapfile of line_count data blocks of random sizes and statuses, laid out as ddrescue writes them
+bool writeSyntheticMapfile(const QString &file_name, int line_count, unsigned seed = 1);
+// the same blocks in memory
+BlockTable syntheticBlocks(int count, unsigned seed = 1);
+
+// tests/Seagate1.mapfile of the source tree
+QString fixtureMapfile();
+
+// the best of repeat runs in nanoseconds, the other runs being slowed down by the rest of the system
+qint64 bestTime(int repeat, const std::function<void()> &run);
+
+// comma separated counts, e.g. "1000000,4000000", false when one is invalid
+bool toCounts(const QString &text, QList<int> *counts);
+
+#endif // BENCH_MAPS_H
@@ -0,0 +1,80 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "paint_bench.h"
+#include "palette_bench.h"
+#include "parse_bench.h"
+
+// Qt headers
+#include <QApplication>
+#include <QTextStream>
+
+namespace {
+
+struct Benchmark
+{
+    const char *name;
+    const char *description;
+    int (*run)(const QStringList &arguments);
+};
+
+const Benchmark benchmarks[] = {
+    { "parse", "Parse mapfiles, in MB/s and lines/s.", parseBench },
+    { "palette", "Convert the statuses of the squares to pixels, in squares/s.", paletteBench },
+    { "paint", "Render the map views offscreen, in ms per frame.", paintBench },
+};
+
+int usage(QTextStream &out)
+{
+    out << "Usage: kddrescueview-bench <benchmark> [options]\n\nBenchmarks:\n";
+    for (const Benchmark &benchmark : benchmarks) {
+        out << "  " << QString::fromLatin1(benchmark.name).leftJustified(10) << benchmark.description << '\n';
+    }
+    out << "\nSee kddrescueview-bench <benchmark> --help for the options of a benchmark.\n";
+    out.flush();
+    return 1;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    // the map views are rendered without any display
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("kddrescueview-bench"));
+    QCoreApplication::setApplicationVersion(QStringLiteral("0.1"));
+
+    const QStringList arguments = app.arguments();
+    const QString name = arguments.value(1);
+    for (const Benchmark &benchmark : benchmarks) {
+        if (name == QLatin1String(benchmark.name)) {
+            return benchmark.run(arguments);
+        }
+    }
+    QTextStream err(stderr);
+    if (!name.isEmpty() && name != QLatin1String("--help") && name != QLatin1String("-h")) {
+        err << "kddrescueview-bench: unknown benchmark " << name << "\n\n";
+    }
+    return usage(err);
+}
@@ -0,0 +1,172 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "paint_bench.h"
+#include "bench_maps.h"
+#include "rescue_map.h"
+#include "rescue_map_view.h"
+#include "rescue_map_widget.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QTextStream>
+
+#include <functional>
+
+namespace {
+
+struct Options
+{
+    QSize size;
+    int square_size;
+    int frames;
+};
+
+/*
+ * The time per frame of rendering the whole view after each change
+ */
+void benchFrames(QTextStream &out, const char *view_name, const char *mode, QWidget *view, int frames,
+                 const std::function<void(int frame)> &change)
+{
+    QImage image(view->size(), QImage::Format_ARGB32_Premultiplied);
+    view->render(&image);  // the caches of the views are filled as by the first paint
+    QElapsedTimer timer;
+    timer.start();
+    for (int frame = 0; frame < frames; ++frame) {
+        change(frame);
+        view->render(&image);
+    }
+    const qint64 nsecs = qMax(timer.nsecsElapsed(), qint64(1));
+    out << QString::fromLatin1(view_name).leftJustified(18)
+        << QString::fromLatin1(mode).leftJustified(10)
+        << QString::number(frames).rightJustified(6) << " frames "
+        << QString::number(nsecs / 1e6 / frames, 'f', 3).rightJustified(10) << " ms/frame "
+        << QString::number(frames * 1e9 / nsecs, 'f', 1).rightJustified(8) << " frames/s\n";
+    out.flush();
+}
+
+/*
+ * The view shows the map, which it sizes once shown
+ */
+void benchView(QTextStream &out, const char *view_name, QWidget *view, RescueMap *map,
+               const BlockTable &blocks, const BlockTable &refreshed, const Options &options)
+{
+    map->setMap(blocks);
+    view->resize(options.size);
+    view->show();
+    QCoreApplication::processEvents();
+
+    benchFrames(out, view_name, "expose", view, options.frames, [](int) {});
+    benchFrames(out, view_name, "refresh", view, options.frames, [&](int frame) {
+        map->setMap((frame % 2) ? blocks : refreshed);
+    });
+
+    /* zoomed in 64 times, one row further per frame */
+    const qint64 square_bytes = qMax(map->squareBytes() / 64 / 512, qint64(1)) * 512;
+    const qint64 row_bytes = square_bytes * map->columns();
+    const qint64 start = map->start().data();
+    benchFrames(out, view_name, "scroll", view, options.frames, [&](int frame) {
+        map->setWindow(start + (frame + 1) * row_bytes, square_bytes);
+    });
+    map->fitWindow();
+    view->hide();
+}
+
+/* the same domain with the status of one block in a hundred changed */
+BlockTable refreshBlocks(const BlockTable &blocks)
+{
+    BlockTable refreshed;
+    for (int i = 0; i < blocks.count(); ++i) {
+        const BlockStatus::Code status = (i % 100 == 0) ? BlockStatus::Recovered : blocks.status(i);
+        refreshed.append(blocks.position(i).data(), blocks.size(i).data(), status);
+    }
+    return refreshed;
+}
+
+bool toSize(const QString &text, QSize *size)
+{
+    const QStringList items = text.split(QLatin1Char('x'));
+    bool width_ok = false;
+    bool height_ok = false;
+    if (items.count() == 2) {
+        *size = QSize(items.at(0).toInt(&width_ok), items.at(1).toInt(&height_ok));
+    }
+    return width_ok && height_ok && !size->isEmpty();
+}
+
+}
+
+int paintBench(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Time the painting of the map views."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("paint"), QStringLiteral("Benchmark."));
+    const QCommandLineOption blocks_option(QStringLiteral("blocks"),
+        QStringLiteral("Blocks of the synthetic map (default: 1000000)."), QStringLiteral("count"),
+        QStringLiteral("1000000"));
+    const QCommandLineOption frames_option(QStringLiteral("frames"),
+        QStringLiteral("Frames rendered per view and change (default: 100)."), QStringLiteral("count"),
+        QStringLiteral("100"));
+    const QCommandLineOption size_option(QStringLiteral("size"),
+        QStringLiteral("Size of the views in pixels (default: 1280x800)."), QStringLiteral("widthxheight"),
+        QStringLiteral("1280x800"));
+    const QCommandLineOption square_size_option(QStringLiteral("square-size"),
+        QStringLiteral("Size of the squares in pixels (default: 8)."), QStringLiteral("pixels"),
+        QStringLiteral("8"));
+    parser.addOptions({blocks_option, frames_option, size_option, square_size_option});
+    parser.process(arguments);
+
+    QTextStream err(stderr);
+    Options options;
+    bool blocks_ok = false;
+    bool frames_ok = false;
+    bool square_size_ok = false;
+    const int block_count = parser.value(blocks_option).toInt(&blocks_ok);
+    options.frames = parser.value(frames_option).toInt(&frames_ok);
+    options.square_size = parser.value(square_size_option).toInt(&square_size_ok);
+    if (!blocks_ok || block_count <= 0 || !frames_ok || options.frames <= 0
+            || !square_size_ok || options.square_size <= 0 || !toSize(parser.value(size_option), &options.size)) {
+        err << "paint: invalid count or size\n";
+        return 1;
+    }
+
+    const BlockTable blocks = syntheticBlocks(block_count);
+    const BlockTable refreshed = refreshBlocks(blocks);
+    QTextStream out(stdout);
+    {
+        RescueMap map;
+        RescueMapWidget widget;
+        widget.setSquareSize(options.square_size);
+        widget.setMap(&map);
+        benchView(out, "RescueMapWidget", &widget, &map, blocks, refreshed, options);
+    }
+    {
+        RescueMap map;
+        RescueMapView view;
+        view.setModel(&map);
+        view.setSquareSize(options.square_size);
+        benchView(out, "RescueMapView", &view, &map, blocks, refreshed, options);
+    }
+    return 0;
+}
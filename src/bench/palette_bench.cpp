@@ -0,0 +1,112 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "palette_bench.h"
+#include "bench_maps.h"
+#include "square_color.h"
+#include "square_palette.h"
+
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QVector>
+
+#include <random>
+
+namespace {
+
+void printRate(QTextStream &out, const char *mode, int squares, qint64 nsecs, qint64 scalar_nsecs)
+{
+    const double seconds = qMax(nsecs, qint64(1)) / 1e9;
+    out << QString::fromLatin1(mode).leftJustified(12)
+        << QString::number(squares).rightJustified(10) << " squares "
+        << QString::number(nsecs / 1e6, 'f', 3).rightJustified(10) << " ms "
+        << QString::number(squares / 1e6 / seconds, 'f', 1).rightJustified(8) << " Msquares/s "
+        << QString::number(double(scalar_nsecs) / qMax(nsecs, qint64(1)), 'f', 2).rightJustified(6) << "x scalar\n";
+    out.flush();
+}
+
+void bench(QTextStream &out, int squares, int repeat)
+{
+    std::mt19937 random(1);
+    QVector<quint8> masks(squares);
+    for (quint8 &mask : masks) {
+        mask = quint8(random() % SquarePalette::mask_count);
+    }
+    QVector<QRgb> pixels(squares);
+
+    static const struct {
+        const char *name;
+        SquarePalette::Kernel kernel;
+    } kernels[] = { { "scalar", SquarePalette::Scalar }, { "sse4.1", SquarePalette::Sse41 }, { "avx2", SquarePalette::Avx2 } };
+    qint64 scalar_nsecs = 0;
+    for (const auto &kernel : kernels) {
+        if (!SquarePalette::isSupported(kernel.kernel)) {
+            continue;
+        }
+        const qint64 nsecs = bestTime(repeat, [&]() {
+            SquarePalette::toPixels(masks.constData(), pixels.data(), squares, kernel.kernel);
+        });
+        if (kernel.kernel == SquarePalette::Scalar) {
+            scalar_nsecs = nsecs;
+        }
+        printRate(out, kernel.name, squares, nsecs, scalar_nsecs);
+    }
+
+    const qint64 nsecs = bestTime(repeat, [&]() {
+        for (int square = 0; square < squares; ++square) {
+            pixels[square] = SquareColor(masks.at(square)).rgba();
+        }
+    });
+    printRate(out, "SquareColor", squares, nsecs, scalar_nsecs);
+}
+
+}
+
+int paletteBench(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Time the conversion of the status masks of the squares to pixels."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("palette"), QStringLiteral("Benchmark."));
+    const QCommandLineOption squares_option(QStringLiteral("squares"),
+        QStringLiteral("Squares of the grids (default: 4096,1000000)."),
+        QStringLiteral("count,..."), QStringLiteral("4096,1000000"));
+    const QCommandLineOption repeat_option(QStringLiteral("repeat"),
+        QStringLiteral("Conversions of each grid, the best one is printed (default: 20)."), QStringLiteral("count"),
+        QStringLiteral("20"));
+    parser.addOptions({squares_option, repeat_option});
+    parser.process(arguments);
+
+    QTextStream err(stderr);
+    QList<int> square_counts;
+    bool ok = false;
+    const int repeat = parser.value(repeat_option).toInt(&ok);
+    if (!ok || repeat <= 0 || !toCounts(parser.value(squares_option), &square_counts)) {
+        err << "palette: invalid count\n";
+        return 1;
+    }
+
+    QTextStream out(stdout);
+    for (const int squares : square_counts) {
+        bench(out, squares, repeat);
+    }
+    return 0;
+}
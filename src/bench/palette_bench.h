@@ -0,0 +1,36 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PALETTE_BENCH_H
+#define PALETTE_BENCH_H
+
+#include <QStringList>
+
+/**
+ * kddrescueview-bench palette [options]
+ *
+ * Time SquarePalette::toPixels on grids of random status masks with each loop the
+ * processor supports, and constructing a SquareColor per square as the grid did
+ * before the palette, and print the squares converted per second.
+ */
+int paletteBench(const QStringList &arguments);
+
+#endif // PALETTE_BENCH_H
@@ -0,0 +1,167 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "parse_bench.h"
+#include "bench_maps.h"
+#include "block_status.h"
+#include "mapfile_parser.h"
+
+#include <QCommandLineParser>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+namespace {
+
+void printRate(QTextStream &out, const QString &mapfile, const char *mode, qint64 bytes, qint64 lines, qint64 nsecs)
+{
+    const double seconds = qMax(nsecs, qint64(1)) / 1e9;
+    out << QFileInfo(mapfile).fileName().leftJustified(24)
+        << QString::number(lines).rightJustified(10) << " lines "
+        << QString::number(bytes / 1e6, 'f', 1).rightJustified(8) << " MB  "
+        << QString::fromLatin1(mode).leftJustified(10)
+        << QString::number(nsecs / 1e6, 'f', 2).rightJustified(10) << " ms "
+        << QString::number(bytes / 1e6 / seconds, 'f', 1).rightJustified(8) << " MB/s "
+        << QString::number(lines / 1e6 / seconds, 'f', 2).rightJustified(7) << " Mlines/s\n";
+    out.flush();
+}
+
+/*
+ * The mapfile with the status of its middle block changed, as by ddrescue between two
+ * refreshes: an empty array when there is no block line there
+ */
+QByteArray changeMiddleBlock(const QByteArray &mapfile)
+{
+    const int line = mapfile.indexOf('\n', mapfile.size() / 2) + 1;
+    const int newline = mapfile.indexOf('\n', line);
+    if (line <= 0 || newline <= line || !BlockStatus::isValid(mapfile.at(newline - 1))) {
+        return QByteArray();
+    }
+    QByteArray changed = mapfile;
+    changed[newline - 1] = (mapfile.at(newline - 1) == '+') ? '-' : '+';
+    return changed;
+}
+
+/*
+ * Parse the mapfile again after a change of one block, given the previous parse
+ */
+void benchReload(QTextStream &out, const QString &mapfile, int repeat)
+{
+    QFile file(mapfile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    const QByteArray content = file.readAll();
+    const QByteArray changed = changeMiddleBlock(content);
+    if (changed.isEmpty()) {
+        return;
+    }
+    MapfileParser previous;
+    previous.setIncremental(true);
+    if (!previous.parse(content.constData(), content.constData() + content.size())) {
+        return;
+    }
+    MapfileParser parser;
+    parser.setIncremental(true);
+    const qint64 nsecs = bestTime(repeat, [&]() {
+        parser.parse(changed.constData(), changed.constData() + changed.size(), &previous);
+    });
+    printRate(out, mapfile, "reload", changed.size(), parser.lineCount(), nsecs);
+}
+
+/*
+ * Parse a mapfile repeat times per mode, false if it cannot be parsed: in parallel and
+ * on a single thread, in parallel with the digest for the next reload, and a reload
+ */
+bool bench(QTextStream &out, QTextStream &err, const QString &mapfile, int repeat)
+{
+    const qint64 bytes = QFileInfo(mapfile).size();
+    static const struct {
+        const char *name;
+        bool parallel;
+        bool incremental;
+    } modes[] = { { "parallel", true, false }, { "single", false, false }, { "digest", true, true } };
+    for (const auto &mode : modes) {
+        MapfileParser parser;
+        parser.setParallel(mode.parallel);
+        parser.setIncremental(mode.incremental);
+        bool ok = true;
+        const qint64 nsecs = bestTime(repeat, [&]() { ok = parser.parseFile(mapfile) && ok; });
+        if (!ok) {
+            err << mapfile << ": " << parser.errorString() << '\n';
+            return false;
+        }
+        printRate(out, mapfile, mode.name, bytes, parser.lineCount(), nsecs);
+    }
+    benchReload(out, mapfile, repeat);
+    return true;
+}
+
+}
+
+int parseBench(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Time the parsing of GNU ddrescue mapfiles."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("parse"), QStringLiteral("Benchmark."));
+    parser.addPositionalArgument(QStringLiteral("mapfiles"), QStringLiteral("Other mapfile(s) to parse."),
+                                 QStringLiteral("[mapfile...]"));
+    const QCommandLineOption lines_option(QStringLiteral("lines"),
+        QStringLiteral("Data lines of the synthetic mapfiles (default: 1000000,4000000)."),
+        QStringLiteral("count,..."), QStringLiteral("1000000,4000000"));
+    const QCommandLineOption repeat_option(QStringLiteral("repeat"),
+        QStringLiteral("Parses of each mapfile, the best one is printed (default: 5)."), QStringLiteral("count"),
+        QStringLiteral("5"));
+    parser.addOptions({lines_option, repeat_option});
+    parser.process(arguments);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    QList<int> line_counts;
+    bool ok = false;
+    const int repeat = parser.value(repeat_option).toInt(&ok);
+    if (!ok || repeat <= 0 || !toCounts(parser.value(lines_option), &line_counts)) {
+        err << "parse: invalid count\n";
+        return 1;
+    }
+
+    QStringList mapfiles { fixtureMapfile() };
+    QTemporaryDir directory;
+    for (const int line_count : line_counts) {
+        const QString mapfile = directory.filePath(QStringLiteral("synthetic-%1.mapfile").arg(line_count));
+        if (!writeSyntheticMapfile(mapfile, line_count)) {
+            err << "parse: cannot write " << mapfile << '\n';
+            return 1;
+        }
+        mapfiles.append(mapfile);
+    }
+    mapfiles += parser.positionalArguments().mid(1);
+
+    int failures = 0;
+    for (const QString &mapfile : mapfiles) {
+        if (!bench(out, err, mapfile, repeat)) {
+            ++failures;
+        }
+    }
+    return failures ? 1 : 0;
+}
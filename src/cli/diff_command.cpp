@@ -0,0 +1,141 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "diff_command.h"
+#include "map_diff.h"
+#include "mapfile_parser.h"
+
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QtConcurrentRun>
+
+namespace {
+
+QString toHex(qint64 value)
+{
+    return QStringLiteral("0x%1").arg(value, 8, 16, QLatin1Char('0')).toUpper().replace(QLatin1String("0X"), QLatin1String("0x"));
+}
+
+QString transition(BlockStatus::Code before, BlockStatus::Code after)
+{
+    return QString(QLatin1Char(BlockStatus::toChar(before))) + QLatin1Char(BlockStatus::toChar(after));
+}
+
+}
+
+int diffCommand(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Compare two snapshots of a GNU ddrescue mapfile."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("diff"), QStringLiteral("Command."));
+    parser.addPositionalArgument(QStringLiteral("before"), QStringLiteral("Older mapfile."));
+    parser.addPositionalArgument(QStringLiteral("after"), QStringLiteral("Newer mapfile."));
+    const QCommandLineOption summary_option({QStringLiteral("s"), QStringLiteral("summary")},
+        QStringLiteral("Only print the bytes of each transition."));
+    const QCommandLineOption format_option(QStringLiteral("format"),
+        QStringLiteral("Output format: text or json, one object per line (default: text)."),
+        QStringLiteral("format"), QStringLiteral("text"));
+    parser.addOptions({summary_option, format_option});
+    parser.process(arguments);
+
+    QTextStream err(stderr);
+    const QStringList mapfiles = parser.positionalArguments().mid(1);
+    const QString format = parser.value(format_option);
+    if (mapfiles.count() != 2) {
+        err << "diff: two mapfiles are needed" << '\n';
+        return 1;
+    }
+    if (format != QLatin1String("text") && format != QLatin1String("json")) {
+        err << "diff: unknown format " << format << '\n';
+        return 1;
+    }
+
+    /* both snapshots at once */
+    MapfileParser before;
+    MapfileParser after;
+    QFuture<bool> before_parsed = QtConcurrent::run([&before, &mapfiles]() { return before.parseFile(mapfiles.at(0)); });
+    const bool after_parsed = after.parseFile(mapfiles.at(1));
+    if (!before_parsed.result()) {
+        err << mapfiles.at(0) << ": " << before.errorString() << '\n';
+        return 1;
+    }
+    if (!after_parsed) {
+        err << mapfiles.at(1) << ": " << after.errorString() << '\n';
+        return 1;
+    }
+    const MapDiff diff = MapDiff::compare(before.blocks(), after.blocks());
+
+    QTextStream out(stdout);
+    const bool json = (format == QLatin1String("json"));
+    if (!parser.isSet(summary_option)) {
+        if (!json) {
+            out << "#      pos        size  before  after" << '\n';
+        }
+        for (const MapDiff::Change &change : diff.changes()) {
+            if (json) {
+                QJsonObject object;
+                object.insert(QStringLiteral("position"), double(change.position));
+                object.insert(QStringLiteral("size"), double(change.size));
+                object.insert(QStringLiteral("before"), QString(QLatin1Char(BlockStatus::toChar(change.before))));
+                object.insert(QStringLiteral("after"), QString(QLatin1Char(BlockStatus::toChar(change.after))));
+                out << QJsonDocument(object).toJson(QJsonDocument::Compact) << '\n';
+            } else {
+                out << toHex(change.position) << "  " << toHex(change.size) << "  "
+                    << BlockStatus::toChar(change.before) << "       " << BlockStatus::toChar(change.after) << '\n';
+            }
+        }
+    }
+
+    /* the changed transitions only, the diagonal is the unchanged bytes */
+    QJsonObject transitions;
+    if (!json) {
+        out << "# transition  bytes" << '\n';
+    }
+    for (int from = 0; from < BlockStatus::code_count; ++from) {
+        for (int to = 0; to < BlockStatus::code_count; ++to) {
+            const qint64 bytes = diff.bytes(BlockStatus::Code(from), BlockStatus::Code(to));
+            if (from == to || bytes == 0) {
+                continue;
+            }
+            if (json) {
+                transitions.insert(transition(BlockStatus::Code(from), BlockStatus::Code(to)), double(bytes));
+            } else {
+                out << "# " << BlockStatus::toChar(BlockStatus::Code(from)) << " -> "
+                    << BlockStatus::toChar(BlockStatus::Code(to)) << "      " << bytes << '\n';
+            }
+        }
+    }
+    if (json) {
+        QJsonObject summary;
+        summary.insert(QStringLiteral("transitions"), transitions);
+        summary.insert(QStringLiteral("recovered"), double(diff.highlightedBytes(MapDiff::NewlyRecovered)));
+        summary.insert(QStringLiteral("failed"), double(diff.highlightedBytes(MapDiff::NewlyFailed)));
+        out << QJsonDocument(summary).toJson(QJsonDocument::Compact) << '\n';
+    } else {
+        out << "# newly recovered  " << diff.highlightedBytes(MapDiff::NewlyRecovered) << '\n';
+        out << "# newly failed     " << diff.highlightedBytes(MapDiff::NewlyFailed) << '\n';
+    }
+    out.flush();
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "export_command.h"
+#include "command_options.h"
+#include "map_image_writer.h"
+#include "mapfile_parser.h"
+
+#include <QCommandLineParser>
+#include <QTextStream>
+
+int exportCommand(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Export a GNU ddrescue mapfile to a PNG or PPM image of a fixed resolution."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("export"), QStringLiteral("Command."));
+    parser.addPositionalArgument(QStringLiteral("mapfile"), QStringLiteral("GNU ddrescue mapfile to export."));
+    const QCommandLineOption output_option({QStringLiteral("o"), QStringLiteral("output")},
+        QStringLiteral("Image file, .png or .ppm."), QStringLiteral("file"));
+    const QCommandLineOption bytes_option(QStringLiteral("bytes-per-pixel"),
+        QStringLiteral("Bytes per pixel (default: 512)."), QStringLiteral("bytes"), QStringLiteral("512"));
+    const QCommandLineOption width_option(QStringLiteral("width"),
+        QStringLiteral("Image width in pixels (default: 4096)."), QStringLiteral("pixels"), QStringLiteral("4096"));
+    const QCommandLineOption start_option(QStringLiteral("start"),
+        QStringLiteral("First byte of the range to export (default: the start of the rescue domain)."), QStringLiteral("bytes"));
+    const QCommandLineOption size_option(QStringLiteral("size"),
+        QStringLiteral("Size of the range to export (default: up to the end of the rescue domain)."), QStringLiteral("bytes"));
+    parser.addOptions({output_option, bytes_option, width_option, start_option, size_option});
+    parser.process(arguments);
+
+    QTextStream err(stderr);
+    const QStringList mapfiles = parser.positionalArguments().mid(1);
+    if (mapfiles.count() != 1 || !parser.isSet(output_option)) {
+        err << "export: a mapfile and an --output image are needed" << '\n';
+        return 1;
+    }
+    qint64 bytes_per_pixel = 0;
+    int width = 0;
+    if (!toBytes(parser.value(bytes_option), &bytes_per_pixel) || bytes_per_pixel == 0
+            || !toCount(parser.value(width_option), &width)) {
+        err << "export: invalid resolution" << '\n';
+        return 1;
+    }
+    qint64 start = 0;
+    qint64 size = 0;
+    if ((parser.isSet(start_option) && !toBytes(parser.value(start_option), &start))
+            || (parser.isSet(size_option) && !toBytes(parser.value(size_option), &size))) {
+        err << "export: invalid byte range" << '\n';
+        return 1;
+    }
+
+    MapfileParser mapfile_parser;
+    if (!mapfile_parser.parseFile(mapfiles.first())) {
+        err << mapfiles.first() << ": " << mapfile_parser.errorString() << '\n';
+        return 1;
+    }
+    const BlockTable &blocks = mapfile_parser.blocks();
+    MapImageWriter writer;
+    writer.setBytesPerPixel(bytes_per_pixel);
+    writer.setWidth(width);
+    if (parser.isSet(start_option) || parser.isSet(size_option)) {
+        const qint64 first = parser.isSet(start_option) ? start : blocks.domainStart();
+        writer.setRange(first, parser.isSet(size_option) ? first + size : blocks.domainFinish());
+    }
+    if (!writer.write(blocks, parser.value(output_option))) {
+        err << parser.value(output_option) << ": " << writer.errorString() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "diff_command.h"
+#include "export_command.h"
+#include "merge_command.h"
+#include "render_command.h"
+#include "totals_command.h"
+
+// Qt headers
+#include <QGuiApplication>
+#include <QTextStream>
+
+namespace {
+
+struct Command
+{
+    const char *name;
+    const char *description;
+    int (*run)(const QStringList &arguments);
+};
+
+const Command commands[] = {
+    { "render", "Render mapfiles to PNG images of their grid.", renderCommand },
+    { "export", "Stream a mapfile to an image of a fixed resolution.", exportCommand },
+    { "totals", "Print the rescue totals of mapfiles as JSON lines or CSV.", totalsCommand },
+    { "diff", "Print the status changes between two snapshots of a mapfile.", diffCommand },
+    { "merge", "Combine mapfiles of the same drive with a set operation.", mergeCommand },
+};
+
+int usage(QTextStream &out)
+{
+    out << "Usage: kddrescueview-cli <command> [options]\n\nCommands:\n";
+    for (const Command &command : commands) {
+        out << "  " << QString::fromLatin1(command.name).leftJustified(10) << command.description << '\n';
+    }
+    out << "\nSee kddrescueview-cli <command> --help for the options of a command.\n";
+    out.flush();
+    return 1;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    // the images are painted without any display
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("kddrescueview-cli"));
+    QCoreApplication::setApplicationVersion(QStringLiteral("0.1"));
+
+    const QStringList arguments = app.arguments();
+    const QString name = arguments.value(1);
+    for (const Command &command : commands) {
+        if (name == QLatin1String(command.name)) {
+            return command.run(arguments);
+        }
+    }
+    QTextStream err(stderr);
+    if (!name.isEmpty() && name != QLatin1String("--help") && name != QLatin1String("-h")) {
+        err << "kddrescueview-cli: unknown command " << name << "\n\n";
+    }
+    return usage(err);
+}
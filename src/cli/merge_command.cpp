@@ -0,0 +1,160 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "merge_command.h"
+#include "map_merge.h"
+#include "mapfile_parser.h"
+#include "mapfile_writer.h"
+
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTextStream>
+#include <QVector>
+#include <QtConcurrentMap>
+
+namespace {
+
+struct ParsedMapfile
+{
+    QString error;  // empty when parsed
+    BlockTable blocks;
+};
+
+ParsedMapfile parse(const QString &file_name)
+{
+    ParsedMapfile parsed;
+    MapfileParser parser;
+    if (parser.parseFile(file_name)) {
+        parsed.blocks = parser.blocks();
+    } else {
+        parsed.error = parser.errorString();
+    }
+    return parsed;
+}
+
+struct OperationName
+{
+    const char *name;
+    MapMerge::Operation operation;
+};
+
+const OperationName operation_names[] = {
+    { "or", MapMerge::Union },
+    { "and", MapMerge::Intersection },
+    { "minus", MapMerge::Difference },
+    { "xor", MapMerge::SymmetricDifference },
+    { "invert", MapMerge::Complement },
+};
+
+bool toOperation(const QString &name, MapMerge::Operation *operation)
+{
+    for (const OperationName &operation_name : operation_names) {
+        if (name == QLatin1String(operation_name.name)) {
+            *operation = operation_name.operation;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* status characters, e.g. "-/*" for all the failed blocks */
+bool toStatusMask(const QString &text, quint8 *mask)
+{
+    *mask = 0;
+    for (int i = 0; i < text.size(); ++i) {
+        const char status = text.at(i).toLatin1();
+        if (!BlockStatus::isValid(status)) {
+            return false;
+        }
+        *mask |= 1 << BlockStatus::toCode(status);
+    }
+    return *mask != 0;
+}
+
+}
+
+int mergeCommand(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Combine GNU ddrescue mapfiles of the same drive with a set operation."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("merge"), QStringLiteral("Command."));
+    parser.addPositionalArgument(QStringLiteral("mapfiles"), QStringLiteral("Mapfiles, the first one being the reference."),
+                                 QStringLiteral("mapfile..."));
+    const QCommandLineOption operation_option(QStringLiteral("operation"),
+        QStringLiteral("or (in any mapfile), and (in all), minus (in the first but no other), "
+                       "xor (in an odd number) or invert (not in the single mapfile) (default: or)."),
+        QStringLiteral("operation"), QStringLiteral("or"));
+    const QCommandLineOption statuses_option(QStringLiteral("statuses"),
+        QStringLiteral("Statuses of the blocks the operation works on (default: +)."),
+        QStringLiteral("characters"), QStringLiteral("+"));
+    const QCommandLineOption output_option({QStringLiteral("o"), QStringLiteral("output")},
+        QStringLiteral("Mapfile to write (default: standard output)."), QStringLiteral("file"));
+    parser.addOptions({operation_option, statuses_option, output_option});
+    parser.process(arguments);
+
+    QTextStream err(stderr);
+    const QStringList mapfiles = parser.positionalArguments().mid(1);
+    MapMerge::Operation operation;
+    if (!toOperation(parser.value(operation_option), &operation)) {
+        err << "merge: unknown operation " << parser.value(operation_option) << '\n';
+        return 1;
+    }
+    quint8 status_mask;
+    if (!toStatusMask(parser.value(statuses_option), &status_mask)) {
+        err << "merge: invalid statuses " << parser.value(statuses_option) << '\n';
+        return 1;
+    }
+    if (operation == MapMerge::Complement ? mapfiles.count() != 1 : mapfiles.count() < 2) {
+        err << "merge: " << (operation == MapMerge::Complement ? "one mapfile" : "two mapfiles or more") << " needed" << '\n';
+        return 1;
+    }
+
+    /* all the mapfiles at once */
+    const QVector<ParsedMapfile> parsed = QtConcurrent::blockingMapped<QVector<ParsedMapfile>>(mapfiles, parse);
+    QVector<BlockTable> maps;
+    for (int i = 0; i < parsed.count(); ++i) {
+        if (!parsed.at(i).error.isEmpty()) {
+            err << mapfiles.at(i) << ": " << parsed.at(i).error << '\n';
+            return 1;
+        }
+        maps.append(parsed.at(i).blocks);
+    }
+
+    MapMerge merge(operation);
+    merge.setStatusMask(status_mask);
+    const BlockTable result = merge.merge(maps);
+
+    MapfileWriter writer;
+    writer.setComments({ QStringLiteral("Command line: ") + arguments.join(QLatin1Char(' ')) });
+    bool written;
+    if (parser.isSet(output_option)) {
+        written = writer.write(result, parser.value(output_option));
+    } else {
+        QFile out;
+        written = out.open(stdout, QIODevice::WriteOnly) && writer.write(result, &out);
+    }
+    if (!written) {
+        err << "merge: " << writer.errorString() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,217 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "render_command.h"
+#include "command_options.h"
+#include "block_range.h"
+#include "mapfile_parser.h"
+#include "rescue_map.h"
+#include "rescue_map_painter.h"
+
+#include <QColor>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QPainter>
+#include <QTextStream>
+#include <QVector>
+#include <QtConcurrentMap>
+
+#include <limits>
+
+namespace {
+
+struct RenderOptions
+{
+    int columns;
+    int rows;
+    int square_size;
+    QColor grid_color;  // invalid: no grid lines
+    qint64 start;  // -1 from the start of the domain
+    qint64 size;  // -1 up to the end of the domain
+    bool parallel_parsing;
+};
+
+struct RenderJob
+{
+    QString mapfile;
+    QString output;
+    QString error;
+};
+
+/*
+ * Parse a mapfile and paint its grid, the byte range fitted on the squares
+ */
+bool render(const RenderOptions &options, RenderJob *job)
+{
+    MapfileParser parser;
+    parser.setParallel(options.parallel_parsing);
+    if (!parser.parseFile(job->mapfile)) {
+        job->error = parser.errorString();
+        return false;
+    }
+
+    const BlockTable &blocks = parser.blocks();
+    const qint64 start = (options.start >= 0) ? options.start : blocks.domainStart();
+    /* a size past the largest position means up to the end of the device */
+    const qint64 largest = std::numeric_limits<qint64>::max();
+    qint64 finish = blocks.domainFinish();
+    if (options.size >= 0) {
+        finish = (options.size > largest - start) ? largest : start + options.size;
+    }
+    RescueMap map;
+    map.setDimensions(options.columns, options.rows);
+    if (start == blocks.domainStart() && finish == blocks.domainFinish()) {
+        map.setMap(blocks);
+    } else {
+        map.setMap(BlockRange(blocks, start, finish).toTable());
+        if (map.blocks().isEmpty()) {
+            job->error = QStringLiteral("the byte range is outside of the rescue domain");
+            return false;
+        }
+    }
+
+    RescueMapPainter painter;
+    painter.setMap(&map);
+    painter.setSquareSize(options.square_size);
+    painter.setGridColor(options.grid_color);
+    QImage image(painter.size(), QImage::Format_RGB32);
+    image.fill(Qt::white);
+    QPainter image_painter(&image);
+    const bool painted = painter.paint(&image_painter, image.rect());
+    image_painter.end();
+    if (!painted) {
+        job->error = QStringLiteral("nothing to render on a %1x%2 grid").arg(options.columns).arg(options.rows);
+        return false;
+    }
+
+    if (!image.save(job->output, "PNG")) {
+        job->error = QStringLiteral("cannot write %1").arg(job->output);
+        return false;
+    }
+    return true;
+}
+
+}
+
+int renderCommand(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Render GNU ddrescue mapfiles to PNG images of their grid."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("render"), QStringLiteral("Command."));
+    parser.addPositionalArgument(QStringLiteral("mapfiles"), QStringLiteral("GNU ddrescue mapfile(s) to render."),
+                                 QStringLiteral("mapfile..."));
+    const QCommandLineOption output_option({QStringLiteral("o"), QStringLiteral("output")},
+        QStringLiteral("Image file, for a single mapfile (default: the mapfile name with .png appended)."),
+        QStringLiteral("file"));
+    const QCommandLineOption output_dir_option({QStringLiteral("d"), QStringLiteral("output-dir")},
+        QStringLiteral("Directory of the images, named after the mapfiles."), QStringLiteral("directory"));
+    const QCommandLineOption width_option(QStringLiteral("width"),
+        QStringLiteral("Image width in pixels (default: 1024)."), QStringLiteral("pixels"), QStringLiteral("1024"));
+    const QCommandLineOption height_option(QStringLiteral("height"),
+        QStringLiteral("Image height in pixels (default: 768)."), QStringLiteral("pixels"), QStringLiteral("768"));
+    const QCommandLineOption columns_option(QStringLiteral("columns"),
+        QStringLiteral("Squares per row, instead of the width."), QStringLiteral("count"));
+    const QCommandLineOption rows_option(QStringLiteral("rows"),
+        QStringLiteral("Rows of squares, instead of the height."), QStringLiteral("count"));
+    const QCommandLineOption square_size_option(QStringLiteral("square-size"),
+        QStringLiteral("Square size in pixels, grid line included (default: 8)."), QStringLiteral("pixels"), QStringLiteral("8"));
+    const QCommandLineOption grid_color_option(QStringLiteral("grid-color"),
+        QStringLiteral("Color of the grid lines, or none (default: gray)."), QStringLiteral("color"), QStringLiteral("gray"));
+    const QCommandLineOption start_option(QStringLiteral("start"),
+        QStringLiteral("First byte of the range to render (default: the start of the rescue domain)."), QStringLiteral("bytes"));
+    const QCommandLineOption size_option(QStringLiteral("size"),
+        QStringLiteral("Size of the range to render (default: up to the end of the rescue domain)."), QStringLiteral("bytes"));
+    parser.addOptions({output_option, output_dir_option, width_option, height_option, columns_option, rows_option,
+                       square_size_option, grid_color_option, start_option, size_option});
+    parser.process(arguments);
+
+    QTextStream err(stderr);
+    const QStringList mapfiles = parser.positionalArguments().mid(1);
+    if (mapfiles.isEmpty()) {
+        err << "render: no mapfile given" << '\n';
+        return 1;
+    }
+    if (parser.isSet(output_option) && mapfiles.count() > 1) {
+        err << "render: --output needs a single mapfile, use --output-dir for several" << '\n';
+        return 1;
+    }
+
+    RenderOptions options;
+    int width = 0;
+    int height = 0;
+    if (!toCount(parser.value(square_size_option), &options.square_size)
+            || !toCount(parser.value(width_option), &width)
+            || !toCount(parser.value(height_option), &height)) {
+        err << "render: invalid size in pixels" << '\n';
+        return 1;
+    }
+    options.columns = qMax(width / options.square_size, 1);
+    options.rows = qMax(height / options.square_size, 1);
+    if ((parser.isSet(columns_option) && !toCount(parser.value(columns_option), &options.columns))
+            || (parser.isSet(rows_option) && !toCount(parser.value(rows_option), &options.rows))) {
+        err << "render: invalid count of squares" << '\n';
+        return 1;
+    }
+    const QString grid_color = parser.value(grid_color_option);
+    if (grid_color != QLatin1String("none")) {
+        options.grid_color = QColor(grid_color);
+        if (!options.grid_color.isValid()) {
+            err << "render: invalid grid color " << grid_color << '\n';
+            return 1;
+        }
+    }
+    options.start = -1;
+    options.size = -1;
+    if ((parser.isSet(start_option) && !toBytes(parser.value(start_option), &options.start))
+            || (parser.isSet(size_option) && !toBytes(parser.value(size_option), &options.size))) {
+        err << "render: invalid byte range" << '\n';
+        return 1;
+    }
+    options.parallel_parsing = (mapfiles.count() == 1);  // else one mapfile per core
+
+    QVector<RenderJob> jobs;
+    for (const QString &mapfile : mapfiles) {
+        RenderJob job;
+        job.mapfile = mapfile;
+        if (parser.isSet(output_option)) {
+            job.output = parser.value(output_option);
+        } else if (parser.isSet(output_dir_option)) {
+            job.output = QDir(parser.value(output_dir_option)).filePath(QFileInfo(mapfile).fileName() + QStringLiteral(".png"));
+        } else {
+            job.output = mapfile + QStringLiteral(".png");
+        }
+        jobs.append(job);
+    }
+    QtConcurrent::blockingMap(jobs, [&options](RenderJob &job) { render(options, &job); });
+
+    int failures = 0;
+    for (const RenderJob &job : jobs) {
+        if (!job.error.isEmpty()) {
+            err << job.mapfile << ": " << job.error << '\n';
+            ++failures;
+        }
+    }
+    err.flush();
+    return failures ? 1 : 0;
+}
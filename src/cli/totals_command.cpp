@@ -0,0 +1,184 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "totals_command.h"
+#include "mapfile_parser.h"
+#include "rescue_totals.h"
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QVector>
+#include <QtConcurrentMap>
+
+namespace {
+
+struct MapfileSummary
+{
+    QString file_name;
+    QString error;  // empty when parsed
+    RescueTotals totals;
+    int blocks;
+    qint64 position;
+    QString operation;
+    int pass;
+};
+
+MapfileSummary summarize(const QString &file_name)
+{
+    MapfileSummary summary;
+    summary.file_name = file_name;
+    summary.blocks = 0;
+    summary.position = 0;
+    summary.pass = 0;
+
+    MapfileParser parser;
+    parser.setParallel(false);  // one mapfile per core
+    if (!parser.parseFile(file_name)) {
+        summary.error = parser.errorString();
+        return summary;
+    }
+    summary.totals = RescueTotals(parser.blocks());
+    summary.blocks = parser.blocks().count();
+    summary.position = parser.rescueStatus().currentPosition().data();
+    summary.operation = parser.rescueStatus().currentOperation().data();
+    summary.pass = parser.rescueStatus().currentPass();
+    return summary;
+}
+
+/* the statuses in BlockStatus::Code order */
+const char *const status_keys[BlockStatus::code_count] = {
+    "nontried", "nontrimmed", "nonscraped", "badsectors", "recovered", "unknown"
+};
+
+QString toJson(const MapfileSummary &summary)
+{
+    QJsonObject object;
+    object.insert(QStringLiteral("file"), summary.file_name);
+    if (!summary.error.isEmpty()) {
+        object.insert(QStringLiteral("error"), summary.error);
+    } else {
+        object.insert(QStringLiteral("blocks"), summary.blocks);
+        object.insert(QStringLiteral("position"), double(summary.position));
+        object.insert(QStringLiteral("operation"), summary.operation);
+        object.insert(QStringLiteral("pass"), summary.pass);
+        for (int status = 0; status < BlockStatus::code_count; ++status) {
+            object.insert(QLatin1String(status_keys[status]), double(summary.totals.total(BlockStatus::Code(status)).data()));
+        }
+    }
+    return QString::fromUtf8(QJsonDocument(object).toJson(QJsonDocument::Compact));
+}
+
+QString csvField(const QString &text)
+{
+    if (!text.contains(QLatin1Char(',')) && !text.contains(QLatin1Char('"')) && !text.contains(QLatin1Char('\n'))) {
+        return text;
+    }
+    return QLatin1Char('"') + QString(text).replace(QLatin1Char('"'), QLatin1String("\"\"")) + QLatin1Char('"');
+}
+
+QString csvHeader()
+{
+    QStringList fields = { QStringLiteral("file"), QStringLiteral("blocks"), QStringLiteral("position"),
+                           QStringLiteral("operation"), QStringLiteral("pass") };
+    for (int status = 0; status < BlockStatus::code_count; ++status) {
+        fields.append(QLatin1String(status_keys[status]));
+    }
+    fields.append(QStringLiteral("error"));
+    return fields.join(QLatin1Char(','));
+}
+
+QString toCsv(const MapfileSummary &summary)
+{
+    QStringList fields = { csvField(summary.file_name) };
+    if (summary.error.isEmpty()) {
+        fields << QString::number(summary.blocks) << QString::number(summary.position)
+               << csvField(summary.operation) << QString::number(summary.pass);
+        for (int status = 0; status < BlockStatus::code_count; ++status) {
+            fields.append(QString::number(summary.totals.total(BlockStatus::Code(status)).data()));
+        }
+        fields.append(QString());
+    } else {
+        for (int field = 0; field < 4 + BlockStatus::code_count; ++field) {
+            fields.append(QString());
+        }
+        fields.append(csvField(summary.error));
+    }
+    return fields.join(QLatin1Char(','));
+}
+
+}
+
+int totalsCommand(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Print the rescue totals of GNU ddrescue mapfiles."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("totals"), QStringLiteral("Command."));
+    parser.addPositionalArgument(QStringLiteral("paths"), QStringLiteral("Mapfiles, or directories of mapfiles."),
+                                 QStringLiteral("path..."));
+    const QCommandLineOption format_option(QStringLiteral("format"),
+        QStringLiteral("Output format: json (one object per line) or csv (default: json)."),
+        QStringLiteral("format"), QStringLiteral("json"));
+    parser.addOption(format_option);
+    parser.process(arguments);
+
+    QTextStream err(stderr);
+    const QString format = parser.value(format_option);
+    if (format != QLatin1String("json") && format != QLatin1String("csv")) {
+        err << "totals: unknown format " << format << '\n';
+        return 1;
+    }
+
+    /* the files of directories, in name order, not recursively */
+    QStringList file_names;
+    for (const QString &path : parser.positionalArguments().mid(1)) {
+        if (QFileInfo(path).isDir()) {
+            const QDir dir(path);
+            for (const QString &name : dir.entryList(QDir::Files, QDir::Name)) {
+                file_names.append(dir.filePath(name));
+            }
+        } else {
+            file_names.append(path);
+        }
+    }
+    if (file_names.isEmpty()) {
+        err << "totals: no mapfile given" << '\n';
+        return 1;
+    }
+
+    const QVector<MapfileSummary> summaries = QtConcurrent::blockingMapped<QVector<MapfileSummary>>(file_names, summarize);
+
+    QTextStream out(stdout);
+    if (format == QLatin1String("csv")) {
+        out << csvHeader() << '\n';
+    }
+    int failures = 0;
+    for (const MapfileSummary &summary : summaries) {
+        out << (format == QLatin1String("csv") ? toCsv(summary) : toJson(summary)) << '\n';
+        failures += summary.error.isEmpty() ? 0 : 1;
+    }
+    out.flush();
+    return failures ? 1 : 0;
+}
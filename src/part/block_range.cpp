@@ -0,0 +1,59 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "block_range.h"
+
+BlockRange::BlockRange()
+    : m_blocks(nullptr)
+    , m_first(0)
+    , m_count(0)
+    , m_start(0)
+    , m_finish(0)
+{
+}
+
+/*
+ * Two binary searches find the first and the last block overlapping [start, finish),
+ * clipped to the domain of the table.
+ */
+BlockRange::BlockRange(const BlockTable &blocks, qint64 start, qint64 finish)
+    : BlockRange()
+{
+    m_blocks = &blocks;
+    m_start = qMax(start, blocks.domainStart());
+    m_finish = qMin(finish, blocks.domainFinish());
+    if (blocks.isEmpty() || m_finish <= m_start) {
+        m_start = m_finish = 0;
+        return;
+    }
+    m_first = blocks.find(m_start);
+    m_count = blocks.find(m_finish - 1) - m_first + 1;
+}
+
+BlockTable BlockRange::toTable() const
+{
+    BlockTable table;
+    table.reserve(m_count);
+    for (int i = 0; i < m_count; ++i) {
+        table.append(blockStart(i), blockFinish(i) - blockStart(i), status(i));
+    }
+    return table;
+}
@@ -0,0 +1,64 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BLOCK_RANGE_H
+#define BLOCK_RANGE_H
+
+#include "block_table.h"
+
+/**
+ * Non-owning view of the blocks of a BlockTable overlapping a byte range, e.g. the
+ * blocks of a square of the grid view. The first and last blocks are clipped to the
+ * range. A view is only valid as long as the table it was taken from is not modified:
+ * use toTable() to keep a copy.
+ */
+class BlockRange
+{
+public:
+    BlockRange();
+    BlockRange(const BlockTable &blocks, qint64 start, qint64 finish);
+
+    int count() const { return m_count; }
+    bool isEmpty() const { return m_count == 0; }
+
+    // view of the block at index i of the range, clipped to the range
+    BlockPosition position(int i) const { return BlockPosition(blockStart(i)); }
+    BlockPosition finish(int i) const { return BlockPosition(blockFinish(i)); }
+    BlockSize size(int i) const { return BlockSize(blockFinish(i) - blockStart(i)); }
+    BlockStatus::Code status(int i) const { return m_blocks->status(m_first + i); }
+
+    qint64 domainStart() const { return m_start; }
+    qint64 domainFinish() const { return m_finish; }
+
+    BlockTable toTable() const;
+
+private:
+    qint64 blockStart(int i) const { return i == 0 ? m_start : m_blocks->starts()[m_first + i]; }
+    qint64 blockFinish(int i) const { return i == m_count - 1 ? m_finish : m_blocks->starts()[m_first + i + 1]; }
+
+    const BlockTable *m_blocks;
+    int m_first;
+    int m_count;
+    qint64 m_start;
+    qint64 m_finish;
+};
+
+#endif // BLOCK_RANGE_H
@@ -44,6 +44,34 @@ BlockStatus::BlockStatus(QString status)
     }
 }
 
+BlockStatus::BlockStatus(Code code)
+    :m_status(QLatin1Char(toChar(code)))
+{
+}
+
+BlockStatus::Code BlockStatus::code() const
+{
+    return m_status.isEmpty() ? Unknown : toCode(m_status.at(0).toLatin1());
+}
+
+BlockStatus::Code BlockStatus::toCode(char s)  /* static method */
+{
+    switch (s) {
+        case '?': return NonTried;
+        case '*': return NonTrimmed;
+        case '/': return NonScraped;
+        case '-': return BadSector;
+        case '+': return Recovered;
+        default: return Unknown;
+    }
+}
+
+char BlockStatus::toChar(Code code)  /* static method */
+{
+    static const char characters[code_count] = { '?', '*', '/', '-', '+', 'U' };
+    return code < code_count ? characters[code] : 'U';
+}
+
 bool BlockStatus::isValid() const
 {
     return statuses.count(m_status);
@@ -54,6 +82,14 @@ bool BlockStatus::isValid(QString s)  /* static method */
     return statuses.count(s);
 }
 
+bool BlockStatus::isValid(char s)  /* static method */
+{
+    switch (s) {
+        case '?': case '*': case '/': case '-': case '+': return true;
+        default: return false;
+    }
+}
+
 QDebug operator<<(QDebug dbg, const BlockStatus &s)
 {
     dbg.nospace().noquote() << "Status(" << s.m_status << ": " << statuses.value(s.m_status, "Unknown block status") << ")";
@@ -42,6 +42,17 @@ static const QMap<QString, QString> statuses {
 class BlockStatus
 {
 public:
+    // one-byte status code, e.g. to store millions of blocks in a BlockTable
+    enum Code : quint8 {
+        NonTried,    // '?'
+        NonTrimmed,  // '*'
+        NonScraped,  // '/'
+        BadSector,   // '-'
+        Recovered,   // '+'
+        Unknown      // anything else
+    };
+    static const int code_count = Unknown + 1;
+
     // to be integrated in the meta-objet system
     BlockStatus();
     BlockStatus(const BlockStatus &other);
@@ -49,11 +60,16 @@ public:
 
     // construct from external data
     BlockStatus(QString status);
+    BlockStatus(Code code);
 
     QString data() const { return m_status; }
+    Code code() const;
+    static Code toCode(char s);
+    static char toChar(Code code);
 
     bool isValid() const;
     static bool isValid(QString s);
+    static bool isValid(char s);  // for parsers working on raw bytes
 
     friend QDebug operator<<(QDebug dbg, const BlockStatus &status);
 private:
@@ -0,0 +1,108 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "block_table.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+BlockTable::BlockTable()
+{
+}
+
+/*
+ * Binary search for the block holding position. Returns -1 before the first block
+ * and count() after the last one.
+ */
+int BlockTable::find(qint64 position) const
+{
+    if (isEmpty() || position < m_starts.first()) {
+        return -1;
+    }
+    const qint64 *starts = m_starts.constData();
+    return int(std::upper_bound(starts, starts + count(), position) - starts) - 1
+        + (position >= m_starts.last() ? 1 : 0);
+}
+
+void BlockTable::clear()
+{
+    m_starts.clear();
+    m_statuses.clear();
+}
+
+void BlockTable::reserve(int count)
+{
+    m_starts.reserve(count + 1);
+    m_statuses.reserve(count);
+}
+
+/*
+ * Append a block after the last one. Returns false if the block does not start
+ * where the last block ends.
+ */
+bool BlockTable::append(qint64 position, qint64 size, BlockStatus::Code status)
+{
+    if (m_starts.isEmpty()) {
+        m_starts.append(position);
+    } else if (m_starts.last() != position) {
+        return false;
+    }
+    m_starts.append(position + size);
+    m_statuses.append(status);
+    return true;
+}
+
+/*
+ * Copy count+1 starts and count status codes, which must be contiguous blocks
+ */
+void BlockTable::assign(const qint64 *starts, const quint8 *statuses, int count)
+{
+    if (count <= 0) {
+        clear();
+        return;
+    }
+    m_starts.resize(count + 1);
+    m_statuses.resize(count);
+    memcpy(m_starts.data(), starts, sizeof(qint64) * (count + 1));
+    memcpy(m_statuses.data(), statuses, count);
+}
+
+/*
+ * Append count blocks of another table from index first. Returns false if they
+ * do not start where the last block ends.
+ */
+bool BlockTable::append(const BlockTable &other, int first, int count)
+{
+    if (count <= 0) {
+        return true;
+    }
+    if (m_starts.isEmpty()) {
+        m_starts.append(other.m_starts.at(first));
+    } else if (m_starts.last() != other.m_starts.at(first)) {
+        return false;
+    }
+    const qint64 *starts = other.m_starts.constData() + first + 1;
+    std::copy(starts, starts + count, std::back_inserter(m_starts));
+    const quint8 *statuses = other.m_statuses.constData() + first;
+    std::copy(statuses, statuses + count, std::back_inserter(m_statuses));
+    return true;
+}
@@ -0,0 +1,119 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BLOCK_TABLE_H
+#define BLOCK_TABLE_H
+
+#include "block_position.h"
+#include "block_size.h"
+#include "block_status.h"
+
+#include <QVector>
+
+#include <limits>
+
+/**
+ * Compact storage for the data blocks of a map, as a structure of arrays:
+ * - the start position of each block, followed by the end of the last block
+ *   (block sizes are the difference between consecutive starts);
+ * - the one-byte status code of each block.
+ * A block costs 9 bytes and the blocks are contiguous by construction.
+ *
+ * Tables are implicitly shared like the Qt containers they are made of: copies are
+ * cheap as long as they are not modified.
+ */
+class BlockTable
+{
+public:
+    BlockTable();
+
+    int count() const { return m_statuses.count(); }
+    bool isEmpty() const { return m_statuses.isEmpty(); }
+
+    // view of the block at index i
+    BlockPosition position(int i) const { return BlockPosition(m_starts.at(i)); }
+    BlockPosition finish(int i) const { return BlockPosition(m_starts.at(i+1)); }
+    BlockSize size(int i) const { return BlockSize(m_starts.at(i+1) - m_starts.at(i)); }
+    BlockStatus::Code status(int i) const { return BlockStatus::Code(m_statuses.at(i)); }
+
+    // raw arrays for tight loops: count()+1 starts and count() status codes
+    const qint64 *starts() const { return m_starts.constData(); }
+    const quint8 *statuses() const { return m_statuses.constData(); }
+
+    qint64 domainStart() const { return m_starts.isEmpty() ? 0 : m_starts.first(); }
+    qint64 domainFinish() const { return m_starts.isEmpty() ? 0 : m_starts.last(); }
+    int find(qint64 position) const;
+
+    void clear();
+    void reserve(int count);
+    bool append(qint64 position, qint64 size, BlockStatus::Code status);
+    bool append(const BlockTable &other, int first, int count);
+    bool append(const BlockTable &other) { return append(other, 0, other.count()); }
+    void assign(const qint64 *starts, const quint8 *statuses, int count);  // raw arrays, e.g. mapped from a cache
+
+    static int bytesPerBlock() { return sizeof(qint64) + sizeof(quint8); }
+
+private:
+    QVector<qint64> m_starts;
+    QVector<quint8> m_statuses;
+};
+
+/**
+ * Forward-only cursor over the blocks of a table, for sweeps merging several tables
+ * in position order. Positions outside of the domain have the Unknown status.
+ */
+class BlockCursor
+{
+public:
+    explicit BlockCursor(const BlockTable &blocks)
+        : m_starts(blocks.starts())
+        , m_statuses(blocks.statuses())
+        , m_count(blocks.count())
+        , m_block(0)
+    {
+    }
+
+    // status at position, and the end of the run of that status starting there
+    BlockStatus::Code status(qint64 position, qint64 *run_end)
+    {
+        if (m_count == 0 || position >= m_starts[m_count]) {
+            *run_end = std::numeric_limits<qint64>::max();
+            return BlockStatus::Unknown;
+        }
+        if (position < m_starts[0]) {
+            *run_end = m_starts[0];
+            return BlockStatus::Unknown;
+        }
+        while (m_starts[m_block + 1] <= position) {
+            ++m_block;
+        }
+        *run_end = m_starts[m_block + 1];
+        return BlockStatus::Code(m_statuses[m_block]);
+    }
+
+private:
+    const qint64 *m_starts;
+    const quint8 *m_statuses;
+    int m_count;
+    int m_block;
+};
+
+#endif // BLOCK_TABLE_H
@@ -0,0 +1,185 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "coverage_pyramid.h"
+#include "totals_index.h"
+
+CoveragePyramid::CoveragePyramid()
+    : m_index(nullptr)
+    , m_origin(0)
+    , m_finish(0)
+    , m_leaf_size(512)
+    , m_leaves(0)
+{
+}
+
+void CoveragePyramid::clear()
+{
+    m_index = nullptr;
+    m_origin = m_finish = 0;
+    m_leaf_size = 512;
+    m_leaves = 0;
+    m_level_offsets.clear();
+    m_masks.clear();
+    m_bytes.clear();
+}
+
+void CoveragePyramid::build(const BlockTable &blocks, const TotalsIndex &index)
+{
+    clear();
+    if (blocks.isEmpty()) {
+        return;
+    }
+    m_index = &index;
+    m_origin = blocks.domainStart();
+    m_finish = blocks.domainFinish();
+
+    /* about one leaf per block, up to max_leaves, each of at least one sector */
+    m_leaves = 1;
+    while (m_leaves < blocks.count() && m_leaves < max_leaves) {
+        m_leaves <<= 1;
+    }
+    const qint64 size = m_finish - m_origin;
+    while (m_leaf_size * m_leaves < size) {
+        m_leaf_size <<= 1;
+    }
+
+    m_masks.fill(0, 2 * m_leaves - 1);
+    m_bytes.fill(0, (2 * m_leaves - 1) * BlockStatus::code_count);
+    for (int nodes = m_leaves, offset = 0; nodes > 0; offset += nodes, nodes >>= 1) {
+        m_level_offsets.append(offset);
+    }
+
+    /* leaves: spread each block over the leaves it covers */
+    const qint64 *starts = blocks.starts();
+    const quint8 *statuses = blocks.statuses();
+    quint8 *masks = m_masks.data();
+    qint64 *bytes = m_bytes.data();
+    for (int block = 0; block < blocks.count(); ++block) {
+        const int status = statuses[block];
+        qint64 position = starts[block];
+        while (position < starts[block+1]) {
+            const int leaf = int((position - m_origin) / m_leaf_size);
+            const qint64 leaf_end = qMin(m_origin + (leaf + 1) * m_leaf_size, starts[block+1]);
+            masks[leaf] |= 1 << status;
+            bytes[leaf * BlockStatus::code_count + status] += leaf_end - position;
+            position = leaf_end;
+        }
+    }
+
+    /* upper levels: union of the two children */
+    for (int level = 1; level < levelCount(); ++level) {
+        const int offset = m_level_offsets.at(level);
+        const int children = m_level_offsets.at(level - 1);
+        for (int node = 0; node < nodeCount(level); ++node) {
+            const int left = children + 2 * node;
+            masks[offset + node] = masks[left] | masks[left + 1];
+            for (int status = 0; status < BlockStatus::code_count; ++status) {
+                bytes[(offset + node) * BlockStatus::code_count + status] =
+                    bytes[left * BlockStatus::code_count + status] + bytes[(left + 1) * BlockStatus::code_count + status];
+            }
+        }
+    }
+}
+
+RescueTotals CoveragePyramid::totals(int level, int node) const
+{
+    RescueTotals result;
+    const qint64 *bytes = m_bytes.constData() + (m_level_offsets.at(level) + node) * BlockStatus::code_count;
+    for (int status = 0; status < BlockStatus::code_count; ++status) {
+        result.add(bytes[status], BlockStatus::Code(status));
+    }
+    return result;
+}
+
+quint8 CoveragePyramid::mask(qint64 start, qint64 finish) const
+{
+    start = qMax(start, m_origin);
+    finish = qMin(finish, m_finish);
+    if (m_leaves == 0 || finish <= start) {
+        return 0;
+    }
+
+    const int first = int((start - m_origin) / m_leaf_size);
+    const int last = int((finish - 1 - m_origin) / m_leaf_size);
+    if (first == last) {
+        return leafMask(first, start, finish);
+    }
+    quint8 result = leafMask(first, start, finish) | leafMask(last, start, finish);
+    if (first + 1 < last) {
+        result |= leavesMask(first + 1, last - 1);
+    }
+    return result;
+}
+
+/*
+ * Grid squares of such a size and alignment are single nodes: their masks are read
+ * from one level, without any range query.
+ */
+int CoveragePyramid::nodeLevel(qint64 start, qint64 node_size) const
+{
+    if (m_leaves == 0 || start < m_origin || node_size < m_leaf_size) {
+        return -1;
+    }
+    for (int level = 0; level < levelCount(); ++level) {
+        if (nodeSize(level) == node_size) {
+            return ((start - m_origin) % node_size == 0) ? level : -1;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Statuses present in the part of a leaf within [start, finish)
+ */
+quint8 CoveragePyramid::leafMask(int leaf, qint64 start, qint64 finish) const
+{
+    const quint8 mask = m_masks.at(leaf);
+    const qint64 leaf_start = m_origin + leaf * m_leaf_size;
+    const qint64 leaf_finish = qMin(leaf_start + m_leaf_size, m_finish);
+    const bool covered = start <= leaf_start && leaf_finish <= finish;
+    if (covered || (mask & (mask - 1)) == 0) {
+        return mask;  /* the whole leaf, or a part of a leaf with a single status */
+    }
+    return m_index->totals(qMax(start, leaf_start), qMin(finish, leaf_finish)).mask();
+}
+
+/*
+ * Union of the leaves first to last, from the largest aligned nodes in between
+ */
+quint8 CoveragePyramid::leavesMask(int first, int last) const
+{
+    quint8 result = 0;
+    int begin = first;
+    int end = last + 1;
+    for (int level = 0; begin < end; ++level) {
+        const quint8 *masks = m_masks.constData() + m_level_offsets.at(level);
+        if (begin & 1) {
+            result |= masks[begin++];
+        }
+        if (end & 1) {
+            result |= masks[--end];
+        }
+        begin >>= 1;
+        end >>= 1;
+    }
+    return result;
+}
@@ -0,0 +1,82 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COVERAGE_PYRAMID_H
+#define COVERAGE_PYRAMID_H
+
+#include "block_table.h"
+#include "rescue_totals.h"
+
+#include <QVector>
+
+class TotalsIndex;
+
+/**
+ * Hierarchical summary of a map, like the tree texture of the Python prototype.
+ *
+ * The domain is split into a power of two number of leaves (at most max_leaves) of a
+ * power of two size. Each node of the pyramid stores, for its aligned range, the mask of
+ * the statuses present (bit 1 << BlockStatus::Code) and the byte count of each status.
+ * A node of level k covers 2^k leaves.
+ *
+ * The statuses present in any range are the union of O(log leaves) nodes, plus the
+ * partial leaves at both ends. A partial leaf with a single status needs no lookup;
+ * the others are resolved exactly with the TotalsIndex of the map.
+ */
+class CoveragePyramid
+{
+public:
+    CoveragePyramid();
+
+    // the index must outlive the pyramid, or at least its next build()
+    void build(const BlockTable &blocks, const TotalsIndex &index);
+    void clear();
+
+    int levelCount() const { return m_level_offsets.count(); }
+    int nodeCount(int level) const { return m_leaves >> level; }
+    qint64 nodeSize(int level) const { return m_leaf_size << level; }
+    qint64 origin() const { return m_origin; }
+
+    quint8 mask(int level, int node) const { return m_masks.at(m_level_offsets.at(level) + node); }
+    RescueTotals totals(int level, int node) const;
+    // level of the nodes of node_size bytes aligned on start, or -1 when there is none
+    int nodeLevel(qint64 start, qint64 node_size) const;
+
+    // statuses present in [start, finish), clipped to the map domain
+    quint8 mask(qint64 start, qint64 finish) const;
+
+    static const int max_leaves = 1 << 16;
+
+private:
+    quint8 leafMask(int leaf, qint64 start, qint64 finish) const;
+    quint8 leavesMask(int first, int last) const;
+
+    const TotalsIndex *m_index;
+    qint64 m_origin;
+    qint64 m_finish;
+    qint64 m_leaf_size;
+    int m_leaves;
+    QVector<int> m_level_offsets;  // index of the first node of each level, leaves first
+    QVector<quint8> m_masks;
+    QVector<qint64> m_bytes;  // code_count byte counts per node
+};
+
+#endif // COVERAGE_PYRAMID_H
@@ -24,8 +24,14 @@
 #include "rescue_operation.h"
 #include "rescue_map.h"
 #include "rescue_map_view.h"
+#include "rescue_map_widget.h"
+#include "rescue_minimap.h"
 #include "block_status.h"
 #include "block_position.h"
+#include "mapfile_loader.h"
+#include "mapfile_parser.h"
+#include "mapfile_writer.h"
+#include "rescue_totals.h"
 
 // KF headers
 #include <KPluginFactory>
@@ -33,13 +39,15 @@
 #include <KLocalizedString>
 #include <KActionCollection>
 #include <KStandardAction>
+#include <KFormat>
 
 // Qt headers
 #include <QFileDialog>
-#include <QFile>
-#include <QTextStream>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QSaveFile>
+#include <QTimer>
 #include <QtDebug>
-#include <QRegularExpression>
 #include <QTableView>
 #include <QtWidgets>
 #include <QAction>
@@ -51,6 +59,7 @@ K_PLUGIN_FACTORY(kddrescueviewPartFactory, registerPlugin<kddrescueviewPart>();)
 
 kddrescueviewPart::kddrescueviewPart(QWidget* /* parentWidget */, QObject* parent, const QVariantList& /*args*/)
     : KParts::ReadOnlyPart(parent)
+    , m_loaded_size(-1)
 {
     // set component data
     // the first arg must be the same as the subdirectory into which the part's rc file is installed
@@ -62,6 +71,35 @@ kddrescueviewPart::kddrescueviewPart(QWidget* /* parentWidget */, QObject* paren
     // data model
     m_rescue_map = new RescueMap(this);
     m_rescue_status = RescueStatus();
+
+    // mapfiles are parsed on a worker thread, the current map stays visible meanwhile
+    m_loader = new MapfileLoader(this);
+    m_loader->setCacheEnabled(true);
+    connect(m_loader, &MapfileLoader::progress, this, &kddrescueviewPart::loadingProgress);
+    connect(m_loader, &MapfileLoader::loaded, this, &kddrescueviewPart::mapLoaded);
+    connect(m_loader, &MapfileLoader::failed, this, &kddrescueviewPart::loadingFailed);
+    connect(m_loader, &MapfileLoader::canceled, this, &kddrescueviewPart::loadingCanceled);
+
+    // snapshots to compare with are loaded on a worker thread as well
+    m_snapshot_loader = new MapfileLoader(this);
+    connect(m_snapshot_loader, &MapfileLoader::loaded, this, &kddrescueviewPart::snapshotLoaded);
+    connect(m_snapshot_loader, &MapfileLoader::failed, this, &kddrescueviewPart::snapshotFailed);
+
+    // map images are exported on a worker thread as well
+    m_exporter = new MapImageExporter(this);
+    connect(m_exporter, &MapImageExporter::progress, this, &kddrescueviewPart::exportProgress);
+    connect(m_exporter, &MapImageExporter::exported, this, &kddrescueviewPart::imageExported);
+    connect(m_exporter, &MapImageExporter::failed, this, &kddrescueviewPart::exportFailed);
+    connect(m_exporter, &MapImageExporter::canceled, this, &kddrescueviewPart::exportCanceled);
+
+    // the map is reloaded when ddrescue updates the mapfile, once a burst of changes is over
+    m_file_watcher = new QFileSystemWatcher(this);
+    m_refresh_timer = new QTimer(this);
+    m_refresh_timer->setSingleShot(true);
+    m_refresh_timer->setInterval(500);
+    connect(m_file_watcher, &QFileSystemWatcher::fileChanged, m_refresh_timer, QOverload<>::of(&QTimer::start));
+    connect(m_file_watcher, &QFileSystemWatcher::directoryChanged, m_refresh_timer, QOverload<>::of(&QTimer::start));
+    connect(m_refresh_timer, &QTimer::timeout, this, &kddrescueviewPart::refresh);
     
 /*
     // set internal UI
@@ -77,8 +115,15 @@ kddrescueviewPart::kddrescueviewPart(QWidget* /* parentWidget */, QObject* paren
 
     QWidget *centralWidget = new QWidget;
 
+    m_map_widget = new RescueMapWidget(centralWidget);
+    m_map_widget->setMap(m_rescue_map);
     m_view = new RescueMapView(centralWidget);
     m_view->setModel(m_rescue_map);
+    m_view->hide();
+    m_minimap = new RescueMinimap(centralWidget);
+    m_minimap->setMap(m_rescue_map);
+    connect(m_minimap, &RescueMinimap::positionRequested, m_map_widget, &RescueMapWidget::showPosition);
+    connect(m_map_widget, &RescueMapWidget::selectionChanged, this, &kddrescueviewPart::selectionChanged);
 
     QLabel *squareSizeLabel = new QLabel(tr("Square size:"));
     QSpinBox *squareSizeSpinBox = new QSpinBox;
@@ -86,17 +131,27 @@ kddrescueviewPart::kddrescueviewPart(QWidget* /* parentWidget */, QObject* paren
     squareSizeSpinBox->setMaximum(32);
     squareSizeSpinBox->setValue(8);
 
+    connect(squareSizeSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            m_map_widget, &RescueMapWidget::setSquareSize);
     connect(squareSizeSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
             m_view, &RescueMapView::setSquareSize);
   
     
+    m_progress_label = new QLabel;
+
     QHBoxLayout *controlsLayout = new QHBoxLayout;
     controlsLayout->addWidget(squareSizeLabel);
     controlsLayout->addWidget(squareSizeSpinBox);
     controlsLayout->addStretch(1);
+    controlsLayout->addWidget(m_progress_label);
+
+    QHBoxLayout *mapLayout = new QHBoxLayout;
+    mapLayout->addWidget(m_map_widget);
+    mapLayout->addWidget(m_view);
+    mapLayout->addWidget(m_minimap);
 
     QVBoxLayout *mainLayout = new QVBoxLayout;
-    mainLayout->addWidget(m_view);
+    mainLayout->addLayout(mapLayout);
     mainLayout->addLayout(controlsLayout);
     centralWidget->setLayout(mainLayout);
 
@@ -111,171 +166,376 @@ void kddrescueviewPart::setupActions()
 {
     // see: https://techbase.kde.org/Development/Tutorials/Using_Actions
     // see also: KStandardAction::redisplay
+    m_cancel_action = actionCollection()->addAction(QStringLiteral("file_cancel_loading"));
+    m_cancel_action->setText(i18n("&Cancel Loading"));
+    m_cancel_action->setIcon(QIcon::fromTheme(QStringLiteral("process-stop")));
+    m_cancel_action->setEnabled(false);
+    connect(m_cancel_action, &QAction::triggered, m_loader, &MapfileLoader::cancel);
+
+    QAction *compare_action = actionCollection()->addAction(QStringLiteral("file_compare_snapshot"));
+    compare_action->setText(i18n("Co&mpare With Snapshot..."));
+    compare_action->setIcon(QIcon::fromTheme(QStringLiteral("document-compare")));
+    connect(compare_action, &QAction::triggered, this, &kddrescueviewPart::compareWithSnapshot);
+
+    m_clear_comparison_action = actionCollection()->addAction(QStringLiteral("file_clear_comparison"));
+    m_clear_comparison_action->setText(i18n("C&lear Comparison"));
+    m_clear_comparison_action->setEnabled(false);
+    connect(m_clear_comparison_action, &QAction::triggered, this, &kddrescueviewPart::clearComparison);
+
+    m_export_domain_action = actionCollection()->addAction(QStringLiteral("file_export_domain"));
+    m_export_domain_action->setText(i18n("Export &Domain Mapfile..."));
+    m_export_domain_action->setToolTip(i18n("Write the selected squares as a domain mapfile for ddrescue -m"));
+    m_export_domain_action->setEnabled(false);
+    connect(m_export_domain_action, &QAction::triggered, this, &kddrescueviewPart::exportDomain);
+
+    m_export_action = actionCollection()->addAction(QStringLiteral("file_export_image"));
+    m_export_action->setText(i18n("&Export Image..."));
+    m_export_action->setIcon(QIcon::fromTheme(QStringLiteral("document-export")));
+    connect(m_export_action, &QAction::triggered, this, &kddrescueviewPart::exportImage);
+
+    m_cancel_export_action = actionCollection()->addAction(QStringLiteral("file_cancel_export"));
+    m_cancel_export_action->setText(i18n("Cancel E&xport"));
+    m_cancel_export_action->setIcon(QIcon::fromTheme(QStringLiteral("process-stop")));
+    m_cancel_export_action->setEnabled(false);
+    connect(m_cancel_export_action, &QAction::triggered, m_exporter, &MapImageExporter::cancel);
+
+    // the former grid, painted cell by cell by a QTableView, to compare with the raster view
+    m_item_view_action = actionCollection()->addAction(QStringLiteral("view_item_grid"));
+    m_item_view_action->setText(i18n("Use &Item View Grid"));
+    m_item_view_action->setCheckable(true);
+    connect(m_item_view_action, &QAction::toggled, this, &kddrescueviewPart::useItemView);
+
+    // resizing the grid only reflows the squares, until the domain is fitted again
+    QAction *fit_action = actionCollection()->addAction(QStringLiteral("view_fit_window"));
+    fit_action->setText(i18n("&Fit to Window"));
+    fit_action->setIcon(QIcon::fromTheme(QStringLiteral("zoom-fit-best")));
+    connect(fit_action, &QAction::triggered, this, &kddrescueviewPart::fitToWindow);
+
+    QAction *keep_action = actionCollection()->addAction(QStringLiteral("view_keep_square_bytes"));
+    keep_action->setText(i18n("&Keep Bytes per Square on Resize"));
+    keep_action->setCheckable(true);
+    keep_action->setChecked(true);
+    connect(keep_action, &QAction::toggled, this, &kddrescueviewPart::keepSquareBytes);
+}
+
+void kddrescueviewPart::useItemView(bool enabled)
+{
+    m_map_widget->setVisible(!enabled);
+    m_view->setVisible(enabled);
+}
+
+void kddrescueviewPart::fitToWindow()
+{
+    m_map_widget->fitToWindow();
+}
+
+void kddrescueviewPart::keepSquareBytes(bool keep)
+{
+    m_map_widget->setKeepSquareBytes(keep);
 }
 
 
 /*
- * Parse a GNU ddrescue map file
- * Map file structure is described at https://www.gnu.org/software/ddrescue/manual/ddrescue_manual.html#Mapfile-structure
+ * Start parsing the GNU ddrescue map file on a worker thread
+ * The map is replaced in mapLoaded() once the whole file is parsed.
  */
 bool kddrescueviewPart::openFile()
 {
-    QFile file(localFilePath());
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        return false;
+    m_map_widget->clearSelection();
+    clearComparison();  // the snapshot was one of the previous mapfile
+    m_history.open(RescueHistory::cacheFileName(localFilePath()));
+    m_progress_label->clear();
+    watchFile(localFilePath());
+    load(localFilePath());
+    return true;
+}
+
+void kddrescueviewPart::load(const QString &file_name)
+{
+    const QFileInfo info(file_name);
+    m_loaded_modified = info.lastModified();
+    m_loaded_size = info.size();
+    m_loader->load(file_name);
+    m_cancel_action->setEnabled(true);
+}
+
+/*
+ * Watch the mapfile and its directory: ddrescue may replace the mapfile by renaming
+ * a new file over it, which only shows up in the directory.
+ */
+void kddrescueviewPart::watchFile(const QString &file_name)
+{
+    stopWatching();
+    m_file_watcher->addPath(file_name);
+    m_file_watcher->addPath(QFileInfo(file_name).absolutePath());
+}
+
+void kddrescueviewPart::stopWatching()
+{
+    m_refresh_timer->stop();
+    const QStringList paths = m_file_watcher->files() + m_file_watcher->directories();
+    if (!paths.isEmpty()) {
+        m_file_watcher->removePaths(paths);
     }
+}
 
-    QVector<BlockPosition> positions;
-    QVector<BlockSize> sizes;
-    QVector<BlockStatus> statuses;
-
-    QTextStream stream(&file);
-    while (!stream.atEnd()) {
-        QString line;
-        line = stream.readLine();
-        line = line.trimmed();
-        
-        if (line.isEmpty())
-        {
-            continue;
-        }
-                
-        if (line.startsWith("# Command line:"))
-        {
-            /* try to find if the command line had a specific block size option */
-            QRegularExpression re("(-b|--block-size=)\\s*(?P<blocksize>[0-9]+)");
-            QRegularExpressionMatch match = re.match(line);
-            QString device_block_size;
-            if( match.hasMatch() ) {
-                device_block_size = match.captured("blocksize");
-            } else {
-                device_block_size = "512";
-            }
-            continue;
-        }
-        
-        if (line.startsWith('#'))
-        {
-            /* comment line without a command line */
-            /* TODO: parse comment lines with ddrescue_version, start_time, current_time, human_readable_status */
-            continue;
-        }
-        
-        /* Non-comment lines can be:
-         *  - The former status line with two tokens: current_pos current_status
-         *  - The new status line with three tokens: current_pos current_status current_pass
-         *  - A block information with three tokens: pos size status
-         * Their type is:
-         *  - non-negative long long integer for current_pos
-         *  - Operation (one ASCII character) for current_status 
-         *  - positive decimal integer for current_pass
-         *  - non-negative long long integer for position
-         *  - non-negative long long integer for size
-         *  - Status (one ASCII character) for status
-         * Hence three patterns can be found:
-         *  - (long long int) (char) : former status line
-         *  - (long long int) (char) (int) : new status line
-         *  - (long long int) (long long int) (char) : block information
-         */
-        QStringList tokens;
-        tokens = line.split(QRegularExpression("\\s+"));
-        bool conversion_ok;
-        
-        /* former status line pattern: (quint64 current_position) (char current_operation) (optional comment) */
-        if (tokens.count() == 2 || (tokens.count() > 2 && tokens[2].startsWith("#")))
-        if (tokens[0].toLongLong(&conversion_ok, 0) >= 0)  /* 0: guess the base */
-        if (conversion_ok)
-        if (RescueOperation::isValid(tokens[1]))
-        if (!m_rescue_status.currentOperation().isValid())
-        {
-            m_rescue_status.setCurrentPosition(tokens[1].toLongLong(&conversion_ok, 0));
-            m_rescue_status.setCurrentOperation(tokens[1]);
-            continue;
-            /* qDebug() << "Two-token status line"; */ 
-        }
-        /*
-        else qDebug() << "current operation already set";
-        else qDebug() << "second token not an operation character";
-        else qDebug() << "first token cannot be converted to a position";
-        else qDebug() << "position < 0";
-        else qDebug() << "not a two-token line";
-        */
-        
-        /* status line pattern: (qint64 current_position) (char current_operation) (int current_pass) (optional comment) */
-        if (tokens.count() == 3 || (tokens.count() > 3 && tokens[3].startsWith("#")))
-        if (tokens[0].toLongLong(&conversion_ok, 0) >= 0)  /* 0: guess the base for position */
-        if (conversion_ok)
-        if (RescueOperation::isValid(tokens[1]))
-        if (!m_rescue_status.currentOperation().isValid())
-        if (tokens[2].toInt(&conversion_ok, 10) >= 1)  /* 10: pass number must be in base 10 */
-        if (conversion_ok)
-        {
-            m_rescue_status.setCurrentPosition(tokens[0].toLongLong(&conversion_ok, 0));
-            m_rescue_status.setCurrentOperation(tokens[1]);
-            m_rescue_status.setCurrentPass(tokens[2].toInt(&conversion_ok, 10));
-            /* qDebug() << "Status line"; */
-            continue;
-        }
-        /*
-        else qDebug() << "pass number conversion failed";
-        else qDebug() << "pass number < 1";
-        else qDebug() << "current operation already set";
-        else qDebug() << "not an operation character";
-        else qDebug() << "position conversion failed";
-        else qDebug() << "position < 0";
-        else qDebug() << "not a three-token line";
-        */
-
-        /* block information pattern: (qint64 position) (qint64 size) (char status) (optional comment) */
-        if (tokens.count() == 3 || (tokens.count() > 3 && tokens[3].startsWith("#")))
-        if (tokens[0].toLongLong(&conversion_ok, 0) >= 0)  // == m_rescue_map->lastPosition() + m_rescue_map->lastSize() /* 0: guess the base for position */
-        if (conversion_ok)
-        if (tokens[1].toLongLong(&conversion_ok, 0) > 0)  /* 0: guess the base for size */
-        if (conversion_ok)
-        if (BlockStatus::isValid(tokens[2]))
-        {
-            positions.append(BlockPosition(tokens[0]));
-            sizes.append(BlockSize(tokens[1]));
-            statuses.append(BlockStatus(tokens[2]));
-            continue;
-        }
-        /*
-        else qDebug() << "third token not a status character";
-        else qDebug() << "second token cannot be converted to a size";
-        else qDebug() << "size < 0";
-        else qDebug() << "first token cannot be converted to a position";
-        else qDebug() << "position < 0";
-        else qDebug() << "not a three-token line";
-        */
-
-        qDebug() << "Parsing error: the line does not match a status or block information pattern";
-        qDebug() << QString("Error line: %1").arg(line);
-        file.close();
-        return false;
+void kddrescueviewPart::refresh()
+{
+    const QString file_name = localFilePath();
+    const QFileInfo info(file_name);
+    if (!info.exists()) {
+        return;  // removed for now, the directory watch tells when it is back
     }
 
-    file.close();
-
-    for(int row = 0; row+1 < positions.count(); ++row)
-    {
-        BlockPosition block_start = positions[row];
-        BlockSize block_size = sizes[row];
-        BlockPosition block_finish = block_start + block_size;
-        BlockPosition next_block_start = positions[row+1];
-        QString error;
-        if ( block_finish != next_block_start )
-        {
-            qDebug() << "Error, next block not contiguous!";
-            qDebug() << block_start << " + " << block_size << " =! " << next_block_start;
-            return false;
-        }
+    // a mapfile replaced by a rename is a new file: watch it again
+    m_file_watcher->removePath(file_name);
+    m_file_watcher->addPath(file_name);
 
+    // other files of the directory may have changed, not the mapfile
+    if (info.lastModified() == m_loaded_modified && info.size() == m_loaded_size) {
+        return;
     }
-    m_rescue_map->setMap(positions, sizes, statuses);
+    load(file_name);
+}
 
-    return true;
+void kddrescueviewPart::loadingProgress(qint64 bytes_parsed, qint64 bytes_total, qint64 blocks_found)
+{
+    KFormat format;
+    emit setStatusBarText(i18n("Loading: %1 of %2 parsed, %3 blocks found",
+                               format.formatByteSize(bytes_parsed),
+                               format.formatByteSize(bytes_total),
+                               blocks_found));
+}
+
+void kddrescueviewPart::mapLoaded()
+{
+    m_cancel_action->setEnabled(false);
+    const MapfileParser &parser = m_loader->parser();
+    m_rescue_status = parser.rescueStatus();
+    m_rescue_map->setMap(parser.blocks());
+    emit setStatusBarText(i18np("1 block loaded", "%1 blocks loaded", parser.blocks().count()));
+    if (!m_snapshot.isEmpty()) {
+        showComparison();
+    }
+    recordHistory();
+
+    // a finished rescue will not change any more
+    if (m_rescue_status.currentOperation().data() == QLatin1String("+")) {
+        stopWatching();
+    }
+}
+
+void kddrescueviewPart::loadingFailed(const QString &error)
+{
+    m_cancel_action->setEnabled(false);
+    qDebug() << "Cannot open" << m_loader->fileName() << ":" << error;
+    emit setStatusBarText(i18n("Cannot load %1: %2", m_loader->fileName(), error));
+}
+
+void kddrescueviewPart::loadingCanceled()
+{
+    m_cancel_action->setEnabled(false);
+    emit setStatusBarText(i18n("Loading canceled"));
+}
+
+/*
+ * Append the totals of the snapshot just loaded to the history, and show the speed of
+ * the rescue measured over the last records. The snapshot is dated by the mapfile
+ * header when ddrescue wrote it, by the modification time of the file otherwise.
+ */
+void kddrescueviewPart::recordHistory()
+{
+    const QDateTime time = m_rescue_status.currentTime().isValid() ? m_rescue_status.currentTime() : m_loaded_modified;
+    m_history.append(RescueHistory::capture(time.toMSecsSinceEpoch(), m_rescue_status, RescueTotals(m_rescue_map)));
+    if (m_history.count() < 2) {
+        m_progress_label->clear();
+        return;
+    }
+
+    const quint8 failed_mask = (1 << BlockStatus::NonTrimmed) | (1 << BlockStatus::NonScraped) | (1 << BlockStatus::BadSector);
+    const qreal recovered_rate = m_history.rate(1 << BlockStatus::Recovered);
+    const qreal failed_rate = m_history.rate(failed_mask);
+    KFormat format;
+    QString text = i18n("Recovered: %1/s, failed areas: %2%3/s",
+                        format.formatByteSize(recovered_rate),
+                        failed_rate < 0 ? QStringLiteral("-") : QStringLiteral("+"),
+                        format.formatByteSize(qAbs(failed_rate)));
+    const qint64 remaining = m_history.passRemainingTime();
+    if (remaining >= 0) {
+        text += i18n(", pass ends in %1", format.formatSpelloutDuration(quint64(remaining)));
+    }
+    m_progress_label->setText(text);
+}
+
+/*
+ * Highlight what changed since an older copy of the mapfile, e.g. yesterday's
+ */
+void kddrescueviewPart::compareWithSnapshot()
+{
+    const QString file_name = QFileDialog::getOpenFileName(widget(), i18n("Compare With Snapshot"),
+                                                           QFileInfo(localFilePath()).absolutePath());
+    if (!file_name.isEmpty()) {
+        m_snapshot_loader->load(file_name);
+    }
+}
+
+void kddrescueviewPart::snapshotLoaded()
+{
+    m_snapshot = m_snapshot_loader->parser().blocks();
+    m_clear_comparison_action->setEnabled(true);
+    showComparison();
+}
+
+void kddrescueviewPart::snapshotFailed(const QString &error)
+{
+    qDebug() << "Cannot open" << m_snapshot_loader->fileName() << ":" << error;
+    emit setStatusBarText(i18n("Cannot load %1: %2", m_snapshot_loader->fileName(), error));
+}
+
+void kddrescueviewPart::showComparison()
+{
+    const MapDiff diff = m_rescue_map->diff(m_snapshot);
+    m_rescue_map->setOverlay(diff);
+    KFormat format;
+    emit setStatusBarText(i18n("Since the snapshot: %1 newly recovered, %2 newly failed",
+                               format.formatByteSize(diff.highlightedBytes(MapDiff::NewlyRecovered)),
+                               format.formatByteSize(diff.highlightedBytes(MapDiff::NewlyFailed))));
+}
+
+void kddrescueviewPart::clearComparison()
+{
+    m_snapshot_loader->cancel();
+    m_snapshot.clear();
+    m_rescue_map->clearOverlay();
+    m_clear_comparison_action->setEnabled(false);
+}
+
+/*
+ * Export the whole map at a fixed resolution, e.g. one sector per pixel, whatever the
+ * grid shows. The image is streamed to the file on a worker thread.
+ */
+void kddrescueviewPart::exportImage()
+{
+    if (m_rescue_map->blocks().isEmpty()) {
+        return;
+    }
+    const QString file_name = QFileDialog::getSaveFileName(widget(), i18n("Export Image"), QString(),
+                                                           i18n("PNG images (*.png);;PPM images (*.ppm)"));
+    if (file_name.isEmpty()) {
+        return;
+    }
+    if (!MapImageWriter::isSupported(file_name)) {
+        emit setStatusBarText(i18n("Cannot export %1: unsupported image format", file_name));
+        return;
+    }
+
+    const QStringList resolutions = {
+        i18n("One sector (512 bytes) per pixel"),
+        i18n("One 4 KiB block per pixel"),
+        i18n("One 64 KiB cluster per pixel"),
+    };
+    const qint64 bytes_per_pixel[] = { 512, 4096, 65536 };
+    bool ok = false;
+    const QString resolution = QInputDialog::getItem(widget(), i18n("Export Image"), i18n("Resolution:"),
+                                                     resolutions, 1, false, &ok);
+    if (!ok) {
+        return;
+    }
+    const int export_width = 4096;  // pixels per row
+    m_exporter->exportImage(m_rescue_map->blocks(), file_name, bytes_per_pixel[resolutions.indexOf(resolution)], export_width);
+    m_cancel_export_action->setEnabled(true);
+}
+
+void kddrescueviewPart::exportProgress(qint64 rows_written, qint64 row_count)
+{
+    emit setStatusBarText(i18n("Exporting: %1 of %2 rows written", rows_written, row_count));
+}
+
+void kddrescueviewPart::imageExported()
+{
+    m_cancel_export_action->setEnabled(false);
+    emit setStatusBarText(i18n("Image exported to %1", m_exporter->fileName()));
 }
 
+void kddrescueviewPart::exportFailed(const QString &error)
+{
+    m_cancel_export_action->setEnabled(false);
+    qDebug() << "Cannot export" << m_exporter->fileName() << ":" << error;
+    emit setStatusBarText(i18n("Cannot export %1: %2", m_exporter->fileName(), error));
+}
+
+void kddrescueviewPart::exportCanceled()
+{
+    m_cancel_export_action->setEnabled(false);
+    emit setStatusBarText(i18n("Export canceled"));
+}
+
+void kddrescueviewPart::selectionChanged()
+{
+    const MapSelection &selection = m_map_widget->selection();
+    m_export_domain_action->setEnabled(!selection.isEmpty());
+    if (!selection.isEmpty()) {
+        KFormat format;
+        emit setStatusBarText(i18n("%1 selected", format.formatByteSize(selection.bytes())));
+    }
+}
+
+/*
+ * Write the blocks of the selection, optionally only those of some statuses, as a
+ * domain mapfile to rescue them again with ddrescue -m. The mapfile is streamed from
+ * the current map in one pass.
+ */
+void kddrescueviewPart::exportDomain()
+{
+    MapSelection selection = m_map_widget->selection();
+    if (selection.isEmpty()) {
+        return;
+    }
+
+    const QStringList filters = {
+        i18n("All the blocks"),
+        i18n("Failed blocks (non-trimmed, non-scraped and bad sectors)"),
+        i18n("Bad sectors"),
+        i18n("Non-tried blocks"),
+    };
+    const quint8 status_masks[] = {
+        0xff,
+        (1 << BlockStatus::NonTrimmed) | (1 << BlockStatus::NonScraped) | (1 << BlockStatus::BadSector),
+        1 << BlockStatus::BadSector,
+        1 << BlockStatus::NonTried,
+    };
+    bool ok = false;
+    const QString filter = QInputDialog::getItem(widget(), i18n("Export Domain Mapfile"), i18n("Blocks of the selection:"),
+                                                 filters, 1, false, &ok);
+    if (!ok) {
+        return;
+    }
+    selection.setStatusMask(status_masks[filters.indexOf(filter)]);
+
+    const QString file_name = QFileDialog::getSaveFileName(widget(), i18n("Export Domain Mapfile"),
+                                                           QFileInfo(localFilePath()).absolutePath());
+    if (file_name.isEmpty()) {
+        return;
+    }
+
+    QSaveFile file(file_name);
+    MapfileWriter writer;
+    writer.setComments({ QStringLiteral("Domain of ") + localFilePath() + QStringLiteral(", written by kddrescueview") });
+    qint64 domain_bytes = 0;
+    const bool written = file.open(QIODevice::WriteOnly)
+        && writer.begin(&file)
+        && selection.writeDomain(m_rescue_map->blocks(), &writer, &domain_bytes)
+        && writer.finish()
+        && file.commit();
+    if (!written) {
+        const QString error = writer.errorString().isEmpty() ? file.errorString() : writer.errorString();
+        qDebug() << "Cannot write" << file_name << ":" << error;
+        emit setStatusBarText(i18n("Cannot write %1: %2", file_name, error));
+        return;
+    }
+    KFormat format;
+    emit setStatusBarText(i18n("Domain of %1 written to %2", format.formatByteSize(domain_bytes), file_name));
+}
 
 
 // needed for K_PLUGIN_FACTORY
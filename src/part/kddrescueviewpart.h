@@ -22,16 +22,26 @@
 #ifndef KDDRESCUEVIEWPART_H
 #define KDDRESCUEVIEWPART_H
 
-// #include "rescue_map_widget.h"
+#include "rescue_map_widget.h"
+#include "rescue_minimap.h"
 #include "rescue_status.h"
 #include "rescue_map.h"
 #include "rescue_map_view.h"
+#include "mapfile_loader.h"
+#include "map_image_exporter.h"
+#include "rescue_history.h"
 
 // KF headers
 #include <KParts/ReadOnlyPart>
 
+// Qt headers
+#include <QDateTime>
+
 class QWidget;
 class QAction;
+class QLabel;
+class QFileSystemWatcher;
+class QTimer;
 
 
 /**
@@ -48,13 +58,57 @@ public:
 protected: // KParts::ReadOnlyPart API
     bool openFile() override;
 
+private Q_SLOTS:
+    void loadingProgress(qint64 bytes_parsed, qint64 bytes_total, qint64 blocks_found);
+    void mapLoaded();
+    void loadingFailed(const QString &error);
+    void loadingCanceled();
+    void refresh();
+    void useItemView(bool enabled);
+    void fitToWindow();
+    void keepSquareBytes(bool keep);
+    void exportImage();
+    void exportProgress(qint64 rows_written, qint64 row_count);
+    void imageExported();
+    void exportFailed(const QString &error);
+    void exportCanceled();
+    void compareWithSnapshot();
+    void snapshotLoaded();
+    void snapshotFailed(const QString &error);
+    void clearComparison();
+    void selectionChanged();
+    void exportDomain();
+
 private:
     void setupActions();
+    void showComparison();
+    void recordHistory();
+    void load(const QString &file_name);
+    void watchFile(const QString &file_name);
+    void stopWatching();
 
 private:
-    RescueMapView* m_view;
+    RescueMapWidget* m_map_widget;
+    RescueMinimap* m_minimap;
+    RescueMapView* m_view;  // former item view, kept for comparison
+    QAction* m_item_view_action;
     RescueMap* m_rescue_map;
     RescueStatus m_rescue_status;
+    MapfileLoader* m_loader;
+    QAction* m_cancel_action;
+    MapfileLoader* m_snapshot_loader;  // older copy of the mapfile to compare with
+    BlockTable m_snapshot;
+    QAction* m_clear_comparison_action;
+    QAction* m_export_domain_action;
+    MapImageExporter* m_exporter;
+    QAction* m_export_action;
+    QAction* m_cancel_export_action;
+    QFileSystemWatcher* m_file_watcher;
+    QTimer* m_refresh_timer;
+    RescueHistory m_history;  // totals of the former refreshes, for the speed of the rescue
+    QLabel* m_progress_label;
+    QDateTime m_loaded_modified;
+    qint64 m_loaded_size;
 };
 
 #endif // KDDRESCUEVIEWPART_H
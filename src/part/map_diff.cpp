@@ -0,0 +1,143 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "map_diff.h"
+
+#include <algorithm>
+
+namespace {
+
+bool isFailed(BlockStatus::Code status)
+{
+    return status == BlockStatus::NonTrimmed || status == BlockStatus::NonScraped || status == BlockStatus::BadSector;
+}
+
+}
+
+MapDiff::MapDiff()
+{
+    for (int before = 0; before < BlockStatus::code_count; ++before) {
+        for (int after = 0; after < BlockStatus::code_count; ++after) {
+            m_bytes[before][after] = 0;
+        }
+    }
+}
+
+/* static method */
+MapDiff MapDiff::compare(const BlockTable &before, const BlockTable &after)
+{
+    MapDiff diff;
+    if (before.isEmpty() && after.isEmpty()) {
+        return diff;
+    }
+    qint64 start;
+    qint64 finish;
+    if (before.isEmpty() || after.isEmpty()) {
+        const BlockTable &blocks = before.isEmpty() ? after : before;
+        start = blocks.domainStart();
+        finish = blocks.domainFinish();
+    } else {
+        start = qMin(before.domainStart(), after.domainStart());
+        finish = qMax(before.domainFinish(), after.domainFinish());
+    }
+
+    /* each step ends at the next block boundary of either table */
+    BlockCursor before_cursor(before);
+    BlockCursor after_cursor(after);
+    for (qint64 position = start; position < finish; ) {
+        qint64 before_end;
+        qint64 after_end;
+        const BlockStatus::Code before_status = before_cursor.status(position, &before_end);
+        const BlockStatus::Code after_status = after_cursor.status(position, &after_end);
+        const qint64 end = qMin(qMin(before_end, after_end), finish);
+        diff.add(position, end - position, before_status, after_status);
+        position = end;
+    }
+    return diff;
+}
+
+void MapDiff::add(qint64 position, qint64 size, BlockStatus::Code before, BlockStatus::Code after)
+{
+    m_bytes[before][after] += size;
+    if (before == after) {
+        return;
+    }
+    if (!m_changes.isEmpty()) {
+        Change &last = m_changes.last();
+        if (last.position + last.size == position && last.before == before && last.after == after) {
+            last.size += size;
+            return;
+        }
+    }
+    m_changes.append(Change{position, size, before, after});
+}
+
+qint64 MapDiff::changedBytes() const
+{
+    qint64 result = 0;
+    for (int before = 0; before < BlockStatus::code_count; ++before) {
+        for (int after = 0; after < BlockStatus::code_count; ++after) {
+            result += (before != after) ? m_bytes[before][after] : 0;
+        }
+    }
+    return result;
+}
+
+qint64 MapDiff::highlightedBytes(Highlight highlight) const
+{
+    qint64 result = 0;
+    for (int before = 0; before < BlockStatus::code_count; ++before) {
+        for (int after = 0; after < BlockStatus::code_count; ++after) {
+            if (MapDiff::highlight(BlockStatus::Code(before), BlockStatus::Code(after)) & highlight) {
+                result += m_bytes[before][after];
+            }
+        }
+    }
+    return result;
+}
+
+/* static method */
+quint8 MapDiff::highlight(BlockStatus::Code before, BlockStatus::Code after)
+{
+    if (after == BlockStatus::Recovered && before != BlockStatus::Recovered) {
+        return NewlyRecovered;
+    }
+    if (isFailed(after) && !isFailed(before)) {
+        return NewlyFailed;
+    }
+    return 0;
+}
+
+/*
+ * The changes are sorted and disjoint: the first one ending after start is found by
+ * binary search, then the following ones are merged until finish.
+ */
+quint8 MapDiff::highlight(qint64 start, qint64 finish) const
+{
+    auto change = std::upper_bound(m_changes.constBegin(), m_changes.constEnd(), start,
+                                   [](qint64 position, const Change &c) { return position < c.position + c.size; });
+    quint8 result = 0;
+    const quint8 all = NewlyRecovered | NewlyFailed;
+    for (; change != m_changes.constEnd() && change->position < finish && result != all; ++change) {
+        result |= highlight(change->before, change->after);
+    }
+    return result;
+}
@@ -0,0 +1,77 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAP_DIFF_H
+#define MAP_DIFF_H
+
+#include "block_status.h"
+#include "block_table.h"
+
+#include <QVector>
+
+/**
+ * Changes between two snapshots of a map, e.g. yesterday's and today's copies of a
+ * mapfile, found by merging both block lists in a single linear pass.
+ *
+ * The changes are the byte ranges whose status differs, in position order, adjacent
+ * ranges with the same transition being merged. The bytes of each transition are
+ * counted, the diagonal holding the unchanged bytes of each status. Bytes outside of
+ * the domain of a snapshot have the Unknown status in it.
+ *
+ * For an overlay on the grid, each transition is reduced to highlight bits: a range
+ * newly recovered, or newly failed (non-trimmed, non-scraped or bad sector).
+ */
+class MapDiff
+{
+public:
+    struct Change
+    {
+        qint64 position;
+        qint64 size;
+        BlockStatus::Code before;
+        BlockStatus::Code after;
+    };
+
+    enum Highlight : quint8 {
+        NewlyRecovered = 1,
+        NewlyFailed = 2,
+    };
+
+    MapDiff();
+    static MapDiff compare(const BlockTable &before, const BlockTable &after);
+
+    bool isEmpty() const { return m_changes.isEmpty(); }
+    const QVector<Change> &changes() const { return m_changes; }
+    qint64 bytes(BlockStatus::Code before, BlockStatus::Code after) const { return m_bytes[before][after]; }
+    qint64 changedBytes() const;
+    qint64 highlightedBytes(Highlight highlight) const;
+
+    static quint8 highlight(BlockStatus::Code before, BlockStatus::Code after);
+    quint8 highlight(qint64 start, qint64 finish) const;  // of the changes within [start, finish)
+
+private:
+    void add(qint64 position, qint64 size, BlockStatus::Code before, BlockStatus::Code after);
+
+    QVector<Change> m_changes;
+    qint64 m_bytes[BlockStatus::code_count][BlockStatus::code_count];  // [before][after]
+};
+
+#endif // MAP_DIFF_H
@@ -0,0 +1,101 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "map_image_exporter.h"
+
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+
+MapImageExporter::MapImageExporter(QObject *parent)
+    : QObject(parent)
+    , m_writer(new MapImageWriter)
+    , m_watcher(nullptr)
+{
+    m_progress_timer.setInterval(100);
+    connect(&m_progress_timer, &QTimer::timeout, this, &MapImageExporter::reportProgress);
+}
+
+MapImageExporter::~MapImageExporter()
+{
+    /* the worker threads must not outlive the plugin code they run */
+    cancel();
+    const auto watchers = findChildren<QFutureWatcher<bool>*>();
+    for (QFutureWatcher<bool> *watcher : watchers) {
+        watcher->waitForFinished();
+    }
+}
+
+void MapImageExporter::exportImage(const BlockTable &blocks, const QString &file_name, qint64 bytes_per_pixel, int width)
+{
+    /* a superseded export ends on its own, its result is dropped in finish() */
+    cancel();
+
+    m_file_name = file_name;
+    QSharedPointer<MapImageWriter> writer(new MapImageWriter);
+    writer->setBytesPerPixel(bytes_per_pixel);
+    writer->setWidth(width);
+
+    QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher]() { finish(watcher); });
+    m_watcher = watcher;
+    m_writer = writer;
+    watcher->setFuture(QtConcurrent::run([writer, blocks, file_name]() { return writer->write(blocks, file_name); }));
+
+    m_progress_timer.start();
+    emit started(file_name);
+}
+
+bool MapImageExporter::isExporting() const
+{
+    return m_watcher != nullptr;
+}
+
+void MapImageExporter::cancel()
+{
+    if (m_watcher) {
+        m_writer->cancel();
+    }
+}
+
+void MapImageExporter::reportProgress()
+{
+    emit progress(m_writer->rowsWritten(), m_writer->rowCount());
+}
+
+void MapImageExporter::finish(QFutureWatcher<bool> *watcher)
+{
+    watcher->deleteLater();
+    if (watcher != m_watcher) {
+        return;
+    }
+
+    m_watcher = nullptr;
+    m_progress_timer.stop();
+    reportProgress();
+
+    if (m_writer->isCanceled()) {
+        emit canceled();
+    } else if (!watcher->result()) {
+        emit failed(m_writer->errorString());
+    } else {
+        emit exported();
+    }
+}
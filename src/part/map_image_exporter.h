@@ -0,0 +1,70 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAP_IMAGE_EXPORTER_H
+#define MAP_IMAGE_EXPORTER_H
+
+#include "map_image_writer.h"
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QTimer>
+
+template <typename T> class QFutureWatcher;
+
+/**
+ * Export a map as an image with MapImageWriter on a worker thread, as MapfileLoader
+ * loads mapfiles: progress is reported periodically, and starting a new export
+ * cancels the one in progress.
+ */
+class MapImageExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MapImageExporter(QObject *parent = nullptr);
+    ~MapImageExporter() override;
+
+    void exportImage(const BlockTable &blocks, const QString &file_name, qint64 bytes_per_pixel, int width);
+    bool isExporting() const;
+    QString fileName() const { return m_file_name; }
+
+public slots:
+    void cancel();
+
+signals:
+    void started(const QString &file_name);
+    void progress(qint64 rows_written, qint64 row_count);
+    void exported();
+    void failed(const QString &error);
+    void canceled();
+
+private:
+    void reportProgress();
+    void finish(QFutureWatcher<bool> *watcher);
+
+    QString m_file_name;
+    QSharedPointer<MapImageWriter> m_writer;
+    QFutureWatcher<bool> *m_watcher;
+    QTimer m_progress_timer;
+};
+
+#endif // MAP_IMAGE_EXPORTER_H
@@ -0,0 +1,339 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "map_image_writer.h"
+#include "square_palette.h"
+
+#include <QByteArray>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QScopedPointer>
+#include <QVector>
+
+#ifdef KDDRESCUEVIEW_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+/* rows of RGB pixels written to a device one after the other */
+class ScanlineEncoder
+{
+public:
+    virtual ~ScanlineEncoder() {}
+    virtual bool begin(QIODevice *device, int width, qint64 height) = 0;
+    virtual bool writeRow(const QRgb *pixels) = 0;
+    virtual bool end() = 0;
+
+protected:
+    static void toRgb(const QRgb *pixels, int width, uchar *rgb)
+    {
+        for (int x = 0; x < width; ++x) {
+            *rgb++ = uchar(qRed(pixels[x]));
+            *rgb++ = uchar(qGreen(pixels[x]));
+            *rgb++ = uchar(qBlue(pixels[x]));
+        }
+    }
+};
+
+/* binary portable pixmap: a text header and the raw RGB rows */
+class PpmEncoder : public ScanlineEncoder
+{
+public:
+    bool begin(QIODevice *device, int width, qint64 height) override
+    {
+        m_device = device;
+        m_row.resize(3 * width);
+        const QByteArray header = "P6\n" + QByteArray::number(width) + ' ' + QByteArray::number(height) + "\n255\n";
+        return m_device->write(header) == header.size();
+    }
+
+    bool writeRow(const QRgb *pixels) override
+    {
+        toRgb(pixels, m_row.size() / 3, reinterpret_cast<uchar*>(m_row.data()));
+        return m_device->write(m_row) == m_row.size();
+    }
+
+    bool end() override { return true; }
+
+private:
+    QIODevice *m_device;
+    QByteArray m_row;
+};
+
+#ifdef KDDRESCUEVIEW_HAVE_ZLIB
+
+/*
+ * 8-bit RGB PNG, the rows deflated in a single stream split in IDAT chunks.
+ * Each row uses the Sub filter: runs of the same color become runs of zeros.
+ */
+class PngEncoder : public ScanlineEncoder
+{
+public:
+    PngEncoder()
+        : m_device(nullptr)
+        , m_started(false)
+    {
+    }
+
+    ~PngEncoder() override
+    {
+        if (m_started) {
+            deflateEnd(&m_stream);
+        }
+    }
+
+    bool begin(QIODevice *device, int width, qint64 height) override
+    {
+        if (height > 0x7fffffff) {
+            return false;
+        }
+        m_device = device;
+        m_row.resize(1 + 3 * width);
+        m_rgb.resize(3 * width);
+        m_chunk.resize(chunk_size);
+        m_stream = z_stream();
+        if (deflateInit(&m_stream, Z_BEST_SPEED) != Z_OK) {
+            return false;
+        }
+        m_started = true;
+
+        QByteArray header;
+        appendInt(&header, width);
+        appendInt(&header, int(height));
+        header.append(char(8));  // bit depth
+        header.append(char(2));  // RGB
+        header.append(char(0));  // deflate
+        header.append(char(0));  // adaptive filtering
+        header.append(char(0));  // no interlace
+        static const char signature[] = "\x89PNG\r\n\x1a\n";
+        return m_device->write(signature, 8) == 8 && writeChunk("IHDR", header);
+    }
+
+    bool writeRow(const QRgb *pixels) override
+    {
+        uchar *rgb = reinterpret_cast<uchar*>(m_rgb.data());
+        uchar *row = reinterpret_cast<uchar*>(m_row.data());
+        toRgb(pixels, m_rgb.size() / 3, rgb);
+        row[0] = 1;  // Sub filter
+        for (int i = 0; i < m_rgb.size(); ++i) {
+            row[1 + i] = uchar(rgb[i] - (i >= 3 ? rgb[i - 3] : 0));
+        }
+        return deflateData(reinterpret_cast<const uchar*>(m_row.constData()), m_row.size(), Z_NO_FLUSH);
+    }
+
+    bool end() override
+    {
+        return deflateData(nullptr, 0, Z_FINISH) && writeChunk("IEND", QByteArray());
+    }
+
+private:
+    static const int chunk_size = 1 << 16;
+
+    static void appendInt(QByteArray *data, quint32 value)
+    {
+        data->append(char(value >> 24));
+        data->append(char(value >> 16));
+        data->append(char(value >> 8));
+        data->append(char(value));
+    }
+
+    bool writeChunk(const char *type, const QByteArray &data)
+    {
+        QByteArray chunk;
+        appendInt(&chunk, quint32(data.size()));
+        chunk.append(type, 4);
+        chunk.append(data);
+        const uLong crc = crc32(crc32(0, nullptr, 0), reinterpret_cast<const Bytef*>(chunk.constData() + 4), uInt(chunk.size() - 4));
+        appendInt(&chunk, quint32(crc));
+        return m_device->write(chunk) == chunk.size();
+    }
+
+    /* a full output buffer is an IDAT chunk */
+    bool deflateData(const uchar *data, int size, int flush)
+    {
+        m_stream.next_in = const_cast<Bytef*>(data);
+        m_stream.avail_in = uInt(size);
+        int result = Z_OK;
+        do {
+            if (m_stream.avail_out == 0 || m_stream.next_out == nullptr) {
+                m_stream.next_out = reinterpret_cast<Bytef*>(m_chunk.data());
+                m_stream.avail_out = chunk_size;
+            }
+            result = deflate(&m_stream, flush);
+            if (result == Z_STREAM_ERROR) {
+                return false;
+            }
+            if (m_stream.avail_out == 0 || (flush == Z_FINISH && result == Z_STREAM_END)) {
+                const int produced = chunk_size - int(m_stream.avail_out);
+                if (produced > 0 && !writeChunk("IDAT", QByteArray::fromRawData(m_chunk.constData(), produced))) {
+                    return false;
+                }
+                m_stream.avail_out = 0;  // a new buffer for the next output
+            }
+        } while (m_stream.avail_in > 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+        return true;
+    }
+
+    QIODevice *m_device;
+    z_stream m_stream;
+    bool m_started;
+    QByteArray m_row;  // filter type and filtered bytes
+    QByteArray m_rgb;
+    QByteArray m_chunk;
+};
+
+#endif
+
+ScanlineEncoder *createEncoder(const QString &file_name)
+{
+    const QString suffix = QFileInfo(file_name).suffix().toLower();
+    if (suffix == QLatin1String("ppm")) {
+        return new PpmEncoder;
+    }
+#ifdef KDDRESCUEVIEW_HAVE_ZLIB
+    if (suffix == QLatin1String("png")) {
+        return new PngEncoder;
+    }
+#endif
+    return nullptr;
+}
+
+}
+
+MapImageWriter::MapImageWriter()
+    : m_bytes_per_pixel(512)
+    , m_width(4096)
+    , m_start(0)
+    , m_finish(0)
+    , m_rows_written(0)
+    , m_row_count(0)
+    , m_canceled(0)
+{
+}
+
+void MapImageWriter::setRange(qint64 start, qint64 finish)
+{
+    m_start = start;
+    m_finish = finish;
+}
+
+/* static method */
+bool MapImageWriter::isSupported(const QString &file_name)
+{
+    QScopedPointer<ScanlineEncoder> encoder(createEncoder(file_name));
+    return !encoder.isNull();
+}
+
+bool MapImageWriter::write(const BlockTable &blocks, const QString &file_name)
+{
+    m_rows_written.store(0);
+    QScopedPointer<ScanlineEncoder> encoder(createEncoder(file_name));
+    if (encoder.isNull()) {
+        m_error = QStringLiteral("Unsupported image format, use .png or .ppm");
+        return false;
+    }
+    if (blocks.isEmpty() || m_bytes_per_pixel <= 0 || m_width <= 0) {
+        m_error = QStringLiteral("Nothing to export");
+        return false;
+    }
+
+    const qint64 start = (m_finish > m_start) ? qMax(m_start, blocks.domainStart()) : blocks.domainStart();
+    const qint64 finish = (m_finish > m_start) ? qMin(m_finish, blocks.domainFinish()) : blocks.domainFinish();
+    if (finish <= start) {
+        m_error = QStringLiteral("The range is outside of the rescue domain");
+        return false;
+    }
+    const qint64 row_bytes = m_bytes_per_pixel * m_width;
+    const qint64 row_count = (finish - start + row_bytes - 1) / row_bytes;
+    m_row_count.store(row_count);
+
+    QSaveFile file(file_name);  // no truncated image is left behind on error or cancel
+    if (!file.open(QIODevice::WriteOnly) || !encoder->begin(&file, m_width, row_count)) {
+        m_error = QStringLiteral("Cannot write %1").arg(file_name);
+        return false;
+    }
+
+    /* one scanline at a time, the block cursor only moves forward */
+    QVector<quint8> masks(m_width);
+    QVector<QRgb> pixels(m_width);
+    const qint64 *starts = blocks.starts();
+    const quint8 *statuses = blocks.statuses();
+    const int count = blocks.count();
+    int block = qMax(blocks.find(start), 0);
+    for (qint64 row = 0; row < row_count; ++row) {
+        if (isCanceled()) {
+            file.cancelWriting();
+            m_error = QStringLiteral("Export canceled");
+            return false;
+        }
+        const qint64 row_start = start + row * row_bytes;
+        for (int x = 0; x < m_width; ++x) {
+            const qint64 pixel_start = row_start + x * m_bytes_per_pixel;
+            const qint64 pixel_finish = qMin(pixel_start + m_bytes_per_pixel, finish);
+            quint8 mask = 0;  // lightgray after the end of the range
+            if (pixel_start >= finish) {
+                masks[x] = mask;
+                continue;
+            }
+            while (block < count && starts[block + 1] <= pixel_start) {
+                ++block;
+            }
+            for (int i = block; i < count && starts[i] < pixel_finish; ++i) {
+                mask |= quint8(1 << statuses[i]);
+            }
+            masks[x] = mask;
+        }
+        SquarePalette::toPixels(masks.constData(), pixels.data(), m_width);
+        if (!encoder->writeRow(pixels.constData())) {
+            file.cancelWriting();
+            m_error = QStringLiteral("Cannot write %1").arg(file_name);
+            return false;
+        }
+        m_rows_written.store(row + 1);
+    }
+
+    if (!encoder->end() || !file.commit()) {
+        m_error = QStringLiteral("Cannot write %1").arg(file_name);
+        return false;
+    }
+    return true;
+}
+
+qint64 MapImageWriter::rowsWritten() const
+{
+    return m_rows_written.load();
+}
+
+qint64 MapImageWriter::rowCount() const
+{
+    return m_row_count.load();
+}
+
+void MapImageWriter::cancel()
+{
+    m_canceled.store(1);
+}
+
+bool MapImageWriter::isCanceled() const
+{
+    return m_canceled.load() != 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAP_IMAGE_WRITER_H
+#define MAP_IMAGE_WRITER_H
+
+#include "block_table.h"
+
+#include <QAtomicInteger>
+#include <QString>
+
+/**
+ * Write a map as an image of a fixed byte count per pixel, e.g. one sector or one
+ * 4 KiB block per pixel of a whole drive, with bounded memory.
+ *
+ * The pixels are laid out row by row like the squares of the grid, without grid lines.
+ * The block list is walked once, a scanline at a time, and each scanline is streamed
+ * to the encoder: memory use only depends on the image width, not on its height.
+ *
+ * The format follows the file suffix: binary PPM, or PNG when built with zlib.
+ * The progress getters and cancel() can be called from another thread while writing.
+ */
+class MapImageWriter
+{
+public:
+    MapImageWriter();
+
+    void setBytesPerPixel(qint64 bytes) { m_bytes_per_pixel = bytes; }
+    void setWidth(int pixels) { m_width = pixels; }
+    void setRange(qint64 start, qint64 finish);  // the whole domain by default
+
+    bool write(const BlockTable &blocks, const QString &file_name);
+    QString errorString() const { return m_error; }
+
+    qint64 rowsWritten() const;
+    qint64 rowCount() const;
+    void cancel();
+    bool isCanceled() const;
+
+    static bool isSupported(const QString &file_name);
+
+private:
+    qint64 m_bytes_per_pixel;
+    int m_width;
+    qint64 m_start;
+    qint64 m_finish;  // m_start for the whole domain
+    QString m_error;
+    QAtomicInteger<qint64> m_rows_written;
+    QAtomicInteger<qint64> m_row_count;
+    QAtomicInt m_canceled;
+};
+
+#endif // MAP_IMAGE_WRITER_H
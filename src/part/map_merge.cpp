@@ -0,0 +1,125 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "map_merge.h"
+
+#include <limits>
+#include <vector>
+
+MapMerge::MapMerge(Operation operation)
+    : m_operation(operation)
+    , m_status_mask(1 << BlockStatus::Recovered)
+    , m_inside_status(BlockStatus::Recovered)
+    , m_outside_status(BlockStatus::BadSector)
+{
+}
+
+/*
+ * Statuses of the result where no map agrees with it
+ */
+void MapMerge::setFillStatuses(BlockStatus::Code inside, BlockStatus::Code outside)
+{
+    m_inside_status = inside;
+    m_outside_status = outside;
+}
+
+BlockTable MapMerge::merge(const QVector<BlockTable> &maps) const
+{
+    BlockTable result;
+    qint64 start = std::numeric_limits<qint64>::max();
+    qint64 finish = std::numeric_limits<qint64>::min();
+    std::vector<BlockCursor> cursors;
+    cursors.reserve(maps.count());
+    for (const BlockTable &blocks : maps) {
+        if (!blocks.isEmpty()) {
+            start = qMin(start, blocks.domainStart());
+            finish = qMax(finish, blocks.domainFinish());
+        }
+        cursors.emplace_back(blocks);
+    }
+    if (start >= finish) {
+        return result;
+    }
+
+    /* each step ends at the nearest block boundary of any map; with a few maps, a
+     * linear scan of the cursors beats a heap */
+    std::vector<BlockStatus::Code> statuses(cursors.size());
+    qint64 run_start = start;
+    BlockStatus::Code run_status = BlockStatus::Unknown;
+    for (qint64 position = start; position < finish; ) {
+        qint64 end = finish;
+        for (size_t i = 0; i < cursors.size(); ++i) {
+            qint64 run_end;
+            statuses[i] = cursors[i].status(position, &run_end);
+            end = qMin(end, run_end);
+        }
+        const BlockStatus::Code status = resultStatus(statuses.data(), int(statuses.size()));
+        if (status != run_status) {
+            if (position > run_start) {
+                result.append(run_start, position - run_start, run_status);
+            }
+            run_start = position;
+            run_status = status;
+        }
+        position = end;
+    }
+    result.append(run_start, finish - run_start, run_status);
+    return result;
+}
+
+BlockStatus::Code MapMerge::resultStatus(const BlockStatus::Code *statuses, int count) const
+{
+    bool covered = false;
+    int in_count = 0;
+    for (int i = 0; i < count; ++i) {
+        covered = covered || statuses[i] != BlockStatus::Unknown;
+        in_count += inSet(statuses[i]) ? 1 : 0;
+    }
+    if (!covered) {
+        return BlockStatus::NonTried;  // between the domains of the maps
+    }
+
+    bool inside = false;
+    switch (m_operation) {
+    case Union:
+        inside = in_count > 0;
+        break;
+    case Intersection:
+        inside = in_count == count;
+        break;
+    case Difference:
+        inside = inSet(statuses[0]) && in_count == 1;
+        break;
+    case SymmetricDifference:
+        inside = in_count % 2 == 1;
+        break;
+    case Complement:
+        inside = !inSet(statuses[0]);
+        break;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (statuses[i] != BlockStatus::Unknown && inSet(statuses[i]) == inside) {
+            return statuses[i];
+        }
+    }
+    return inside ? m_inside_status : m_outside_status;
+}
@@ -0,0 +1,77 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAP_MERGE_H
+#define MAP_MERGE_H
+
+#include "block_status.h"
+#include "block_table.h"
+
+#include <QVector>
+
+/**
+ * Set algebra on maps of the same drive, e.g. the mapfiles of several rescue attempts
+ * or of the members of a RAID1 mirror, in the manner of ddrescuelog: the set of a map
+ * holds the bytes whose status is in a chosen status set, the recovered status by
+ * default, and the result is the union, intersection, difference, symmetric difference
+ * or complement of these sets.
+ *
+ * The maps are merged in a single sweep over their block boundaries, each step going
+ * to the nearest boundary of any map. The result is built as it goes, adjacent ranges
+ * of the same status being merged: memory is proportional to the result, whatever the
+ * size of the drive.
+ *
+ * The result keeps the status of the first map whose status agrees with it, in the set
+ * inside the result and out of the set outside. Where no map agrees, as in a
+ * complement, the inside and fill statuses are used, recovered and bad sector by default
+ * as ddrescuelog --invert-mapfile does. Ranges between the domains of the maps are
+ * non-tried.
+ */
+class MapMerge
+{
+public:
+    enum Operation {
+        Union,                // in the set of any map (ddrescuelog --or-mapfile)
+        Intersection,         // in the sets of all maps (--and-mapfile)
+        Difference,           // in the set of the first map but of none of the others
+        SymmetricDifference,  // in the sets of an odd number of maps (--xor-mapfile)
+        Complement,           // not in the set of the first map (--invert-mapfile)
+    };
+
+    explicit MapMerge(Operation operation = Union);
+
+    void setStatusMask(quint8 mask) { m_status_mask = mask; }  // bit (1 << status code) for each status of the set
+    quint8 statusMask() const { return m_status_mask; }
+    void setFillStatuses(BlockStatus::Code inside, BlockStatus::Code outside);
+
+    BlockTable merge(const QVector<BlockTable> &maps) const;
+
+private:
+    bool inSet(BlockStatus::Code status) const { return m_status_mask & (1 << status); }
+    BlockStatus::Code resultStatus(const BlockStatus::Code *statuses, int count) const;
+
+    Operation m_operation;
+    quint8 m_status_mask;
+    BlockStatus::Code m_inside_status;
+    BlockStatus::Code m_outside_status;
+};
+
+#endif // MAP_MERGE_H
@@ -0,0 +1,134 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "map_selection.h"
+#include "block_range.h"
+#include "mapfile_writer.h"
+
+namespace {
+
+/* merges the adjacent runs of the same status before they are written */
+class RunWriter
+{
+public:
+    explicit RunWriter(MapfileWriter *writer)
+        : m_writer(writer)
+        , m_start(0)
+        , m_finish(0)
+        , m_status(BlockStatus::Unknown)
+        , m_ok(true)
+    {
+    }
+
+    void add(qint64 start, qint64 finish, BlockStatus::Code status)
+    {
+        if (start >= finish) {
+            return;
+        }
+        if (status == m_status && start == m_finish) {
+            m_finish = finish;
+            return;
+        }
+        flush();
+        m_start = start;
+        m_finish = finish;
+        m_status = status;
+    }
+
+    bool flush()
+    {
+        if (m_ok && m_finish > m_start) {
+            m_ok = m_writer->append(m_start, m_finish - m_start, m_status);
+        }
+        m_start = m_finish;
+        return m_ok;
+    }
+
+private:
+    MapfileWriter *m_writer;
+    qint64 m_start;
+    qint64 m_finish;
+    BlockStatus::Code m_status;
+    bool m_ok;
+};
+
+}
+
+
+MapSelection::MapSelection()
+    : m_status_mask(0xff)
+{
+}
+
+void MapSelection::addRange(qint64 start, qint64 finish)
+{
+    if (start >= finish) {
+        return;
+    }
+    if (!m_ranges.isEmpty() && start <= m_ranges.last().finish) {
+        m_ranges.last().finish = qMax(m_ranges.last().finish, finish);
+        return;
+    }
+    m_ranges.append(Range{start, finish});
+}
+
+qint64 MapSelection::bytes() const
+{
+    qint64 result = 0;
+    for (const Range &range : m_ranges) {
+        result += range.finish - range.start;
+    }
+    return result;
+}
+
+/*
+ * Stream the domain mapfile of the selection between writer->begin() and
+ * writer->finish(). domain_bytes receives the bytes written as finished.
+ */
+bool MapSelection::writeDomain(const BlockTable &blocks, MapfileWriter *writer, qint64 *domain_bytes) const
+{
+    RunWriter runs(writer);
+    qint64 selected = 0;
+    qint64 position = blocks.domainStart();
+    for (const Range &range : m_ranges) {
+        const qint64 start = qMax(range.start, blocks.domainStart());
+        const qint64 finish = qMin(range.finish, blocks.domainFinish());
+        if (start >= finish) {
+            continue;
+        }
+        runs.add(position, start, BlockStatus::NonTried);
+        const BlockRange range_blocks(blocks, start, finish);
+        for (int i = 0; i < range_blocks.count(); ++i) {
+            const qint64 block_start = range_blocks.position(i).data();
+            const qint64 block_finish = range_blocks.finish(i).data();
+            const bool in_domain = m_status_mask & (1 << range_blocks.status(i));
+            selected += in_domain ? block_finish - block_start : 0;
+            runs.add(block_start, block_finish, in_domain ? BlockStatus::Recovered : BlockStatus::NonTried);
+        }
+        position = finish;
+    }
+    runs.add(position, blocks.domainFinish(), BlockStatus::NonTried);
+
+    if (domain_bytes) {
+        *domain_bytes = selected;
+    }
+    return runs.flush();
+}
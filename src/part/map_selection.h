@@ -0,0 +1,69 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAP_SELECTION_H
+#define MAP_SELECTION_H
+
+#include "block_status.h"
+#include "block_table.h"
+
+#include <QVector>
+
+class MapfileWriter;
+
+/**
+ * Byte ranges selected on a map, e.g. the rows of squares of a rubber band on the
+ * grid, optionally filtered by status, to be given back to ddrescue as a domain
+ * mapfile (ddrescue -m): the selected blocks are written as finished, all the other
+ * bytes of the domain of the map as non-tried.
+ *
+ * The domain mapfile is streamed to a MapfileWriter in a single pass over the blocks
+ * of the selected ranges, found by binary search: the bytes outside of the selection
+ * cost one line per gap, whatever the size of the map.
+ */
+class MapSelection
+{
+public:
+    struct Range
+    {
+        qint64 start;
+        qint64 finish;
+    };
+
+    MapSelection();
+
+    void addRange(qint64 start, qint64 finish);  // in position order, adjacent ranges are merged
+    void clear() { m_ranges.clear(); }
+    bool isEmpty() const { return m_ranges.isEmpty(); }
+    const QVector<Range> &ranges() const { return m_ranges; }
+    qint64 bytes() const;
+
+    void setStatusMask(quint8 mask) { m_status_mask = mask; }  // bit (1 << status code) for each status selected
+    quint8 statusMask() const { return m_status_mask; }
+
+    bool writeDomain(const BlockTable &blocks, MapfileWriter *writer, qint64 *domain_bytes = nullptr) const;
+
+private:
+    QVector<Range> m_ranges;
+    quint8 m_status_mask;
+};
+
+#endif // MAP_SELECTION_H
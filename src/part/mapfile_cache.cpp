@@ -0,0 +1,252 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mapfile_cache.h"
+#include "mapfile_parser.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const char magic[8] = { 'K', 'D', 'D', 'V', 'M', 'A', 'P', 1 };  // the last byte is the format version
+const quint32 byte_order = 0x01020304;
+
+/* followed by block_count + 1 starts, then block_count status codes */
+struct Header
+{
+    char magic[8];
+    quint32 byte_order;
+    quint32 header_size;
+    qint64 file_size;
+    qint64 modified;
+    quint64 content_hash;
+    qint64 block_count;
+    qint64 position;
+    qint64 pass;
+    qint64 operation;     // character of the status line, 0 when unknown
+    qint64 start_time;    // milliseconds since the epoch, -1 when unknown
+    qint64 current_time;
+    qint64 totals[BlockStatus::code_count];
+};
+
+qint64 cacheSize(qint64 block_count)
+{
+    return sizeof(Header) + sizeof(qint64) * (block_count + 1) + block_count;
+}
+
+qint64 toMSecs(const QDateTime &time)
+{
+    return time.isValid() ? time.toMSecsSinceEpoch() : -1;
+}
+
+QDateTime fromMSecs(qint64 msecs)
+{
+    return msecs >= 0 ? QDateTime::fromMSecsSinceEpoch(msecs) : QDateTime();
+}
+
+/* the head, the tail and 32 windows in between: a few hundred KiB of any mapfile */
+quint64 sampleHash(const char *data, qint64 size)
+{
+    const qint64 edge_size = 64 * 1024;
+    const qint64 window_size = 4 * 1024;
+    const int windows = 32;
+    quint64 hash = quint64(size);
+    const auto add = [&hash, data, size](qint64 offset, qint64 length) {
+        length = qMin(length, size - offset);
+        hash = hash * 0x100000001b3ULL ^ qHashBits(data + offset, size_t(length), uint(offset));
+    };
+    add(0, edge_size);
+    add(qMax(size - edge_size, qint64(0)), edge_size);
+    for (int k = 1; k <= windows; ++k) {
+        add(size * k / (windows + 1), window_size);
+    }
+    return hash;
+}
+
+}
+
+
+/* static method */
+bool MapfileCache::fileKey(const QString &mapfile_name, Key *key)
+{
+    QFile file(mapfile_name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    key->size = file.size();
+    key->modified = QFileInfo(mapfile_name).lastModified().toMSecsSinceEpoch();
+    if (key->size == 0) {
+        key->content_hash = 0;
+        return true;
+    }
+    uchar *data = file.map(0, key->size);
+    if (!data) {
+        return false;  // e.g. a pipe, there is nothing to cache
+    }
+    key->content_hash = sampleHash(reinterpret_cast<const char*>(data), key->size);
+    file.unmap(data);
+    return true;
+}
+
+/*
+ * Restore the parse of the mapfile identified by key from cache_name. Returns false
+ * when the cache is missing, stale or damaged: the blocks must be contiguous and add
+ * up to the totals of the header.
+ */
+/* static method */
+bool MapfileCache::read(const QString &cache_name, const Key &key, MapfileParser *parser)
+{
+    QFile file(cache_name);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(Header))) {
+        return false;
+    }
+    uchar *data = file.map(0, file.size());
+    if (!data) {
+        return false;
+    }
+
+    Header header;
+    memcpy(&header, data, sizeof(Header));
+    const bool current = memcmp(header.magic, magic, sizeof(magic)) == 0
+        && header.byte_order == byte_order
+        && header.header_size == sizeof(Header)
+        && header.file_size == key.size
+        && header.modified == key.modified
+        && header.content_hash == key.content_hash
+        && header.block_count > 0 && header.block_count < std::numeric_limits<int>::max()
+        && cacheSize(header.block_count) == file.size();
+    if (!current) {
+        file.unmap(data);
+        return false;
+    }
+
+    const int count = int(header.block_count);
+    const qint64 *starts = reinterpret_cast<const qint64*>(data + sizeof(Header));
+    const quint8 *statuses = reinterpret_cast<const quint8*>(starts + count + 1);
+    qint64 totals[BlockStatus::code_count] = {};
+    bool valid = true;
+    for (int i = 0; i < count && valid; ++i) {
+        valid = starts[i] < starts[i + 1] && statuses[i] < BlockStatus::code_count;
+        if (valid) {
+            totals[statuses[i]] += starts[i + 1] - starts[i];
+        }
+    }
+    for (int status = 0; status < BlockStatus::code_count && valid; ++status) {
+        valid = totals[status] == header.totals[status];
+    }
+    if (!valid) {
+        qDebug() << "Damaged mapfile cache" << cache_name;
+        file.unmap(data);
+        return false;
+    }
+
+    BlockTable blocks;
+    blocks.assign(starts, statuses, count);
+    file.unmap(data);
+
+    RescueStatus status;
+    status.setCurrentPosition(header.position);
+    if (header.operation != 0) {
+        status.setCurrentOperation(QString(QLatin1Char(char(header.operation))));
+    }
+    if (header.pass > 0) {
+        status.setCurrentPass(int(header.pass));
+    }
+    status.setStartTime(fromMSecs(header.start_time));
+    status.setCurrentTime(fromMSecs(header.current_time));
+    parser->restore(blocks, status);
+    return true;
+}
+
+/* static method */
+bool MapfileCache::write(const QString &cache_name, const Key &key, const MapfileParser &parser)
+{
+    const BlockTable &blocks = parser.blocks();
+    if (blocks.isEmpty()) {
+        return false;  // nothing worth caching
+    }
+    const RescueStatus status = parser.rescueStatus();
+    Header header;
+    memset(&header, 0, sizeof(Header));
+    memcpy(header.magic, magic, sizeof(magic));
+    header.byte_order = byte_order;
+    header.header_size = sizeof(Header);
+    header.file_size = key.size;
+    header.modified = key.modified;
+    header.content_hash = key.content_hash;
+    header.block_count = blocks.count();
+    header.position = status.currentPosition().data();
+    header.pass = status.currentPass();
+    const QString operation = status.currentOperation().data();
+    header.operation = operation.isEmpty() ? 0 : operation.at(0).toLatin1();
+    header.start_time = toMSecs(status.startTime());
+    header.current_time = toMSecs(status.currentTime());
+    for (int i = 0; i < blocks.count(); ++i) {
+        header.totals[blocks.status(i)] += blocks.size(i).data();
+    }
+
+    QDir().mkpath(QFileInfo(cache_name).absolutePath());
+    QSaveFile file(cache_name);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Cannot write mapfile cache" << cache_name << ":" << file.errorString();
+        return false;
+    }
+    const qint64 starts_size = qint64(sizeof(qint64)) * (blocks.count() + 1);
+    if (file.write(reinterpret_cast<const char*>(&header), sizeof(Header)) != qint64(sizeof(Header))
+        || file.write(reinterpret_cast<const char*>(blocks.starts()), starts_size) != starts_size
+        || file.write(reinterpret_cast<const char*>(blocks.statuses()), blocks.count()) != blocks.count()
+        || !file.commit()) {
+        qDebug() << "Cannot write mapfile cache" << cache_name << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+/* static method */
+QString MapfileCache::cacheFileName(const QString &mapfile_name)
+{
+    return cachePath(mapfile_name, QStringLiteral("maps"), QStringLiteral(".kddv"));
+}
+
+/*
+ * File of the XDG cache for data about a mapfile, e.g. ~/.cache/kddrescueview/maps/<hash>.kddv,
+ * named after a hash of the absolute path of the mapfile
+ */
+/* static method */
+QString MapfileCache::cachePath(const QString &mapfile_name, const QString &kind, const QString &suffix)
+{
+    const QByteArray path = QFileInfo(mapfile_name).absoluteFilePath().toUtf8();
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+        + QStringLiteral("/kddrescueview/") + kind + QLatin1Char('/')
+        + QString::fromLatin1(QCryptographicHash::hash(path, QCryptographicHash::Sha1).toHex())
+        + suffix;
+}
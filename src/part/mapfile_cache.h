@@ -0,0 +1,67 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPFILE_CACHE_H
+#define MAPFILE_CACHE_H
+
+#include <QString>
+
+class MapfileParser;
+
+/**
+ * Binary cache of a parsed mapfile, to reopen a large mapfile without parsing its
+ * text again. The cache holds the packed block arrays of the BlockTable, the status
+ * line, the header times and the totals of each status.
+ *
+ * A cache file is a fixed header followed by the arrays, in the native byte order and
+ * 8-byte aligned, so that it is read by mapping it: reading a cache is a validation of
+ * the mapping and a copy of the arrays into the table. A cache is only valid for the
+ * mapfile it was written from, identified by a Key: the size and modification time of
+ * the file and a hash of samples of its content (its head, its tail and 32 windows in
+ * between, which does not read the whole file). A stale or damaged cache is refused,
+ * the mapfile is parsed and the cache written again.
+ */
+class MapfileCache
+{
+public:
+    struct Key
+    {
+        qint64 size;
+        qint64 modified;  // milliseconds since the epoch
+        quint64 content_hash;
+
+        bool operator==(const Key &other) const
+        {
+            return size == other.size && modified == other.modified && content_hash == other.content_hash;
+        }
+    };
+
+    static const qint64 min_file_size = 1 << 20;  // smaller mapfiles are parsed in no time
+
+    static bool fileKey(const QString &mapfile_name, Key *key);
+    static bool read(const QString &cache_name, const Key &key, MapfileParser *parser);
+    static bool write(const QString &cache_name, const Key &key, const MapfileParser &parser);
+
+    static QString cacheFileName(const QString &mapfile_name);
+    static QString cachePath(const QString &mapfile_name, const QString &kind, const QString &suffix);
+};
+
+#endif // MAPFILE_CACHE_H
@@ -0,0 +1,243 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mapfile_digest.h"
+
+#include <QHash>
+
+#include <cstring>
+
+namespace {
+
+const qint64 no_boundary = std::numeric_limits<qint64>::max();
+
+}
+
+MapfileDigest::MapfileDigest()
+    : m_valid(false)
+    , m_size(0)
+{
+}
+
+void MapfileDigest::clear()
+{
+    m_valid = false;
+    m_size = 0;
+    m_section.clear();
+    m_head.clear();
+    m_tail.clear();
+}
+
+uint MapfileDigest::hash(const char *window)
+{
+    return qHashBits(window, window_size);
+}
+
+MapfileDigest::Part::Part()
+    : m_section(nullptr)
+    , m_size(0)
+    , m_lines(0)
+    , m_first_head(0)
+    , m_first_tail(-1)
+    , m_next_head(no_boundary)
+    , m_next_tail(no_boundary)
+    , m_next_boundary(no_boundary)
+{
+}
+
+/*
+ * The boundaries of the part are the first ones at or after its start: the boundaries
+ * before are on the lines of the previous part.
+ */
+MapfileDigest::Part::Part(const char *section, const char *section_end, const char *begin)
+    : m_section(section)
+    , m_size(section_end - section)
+    , m_lines(0)
+{
+    const qint64 windows = m_size / window_size;
+    const qint64 start = begin - section;
+
+    /* head window k ends at (k + 1) * window_size */
+    m_first_head = int(qMax(qint64(0), (start + window_size - 1) / window_size - 1));
+    m_next_head = (m_first_head < windows) ? qint64(m_first_head + 1) * window_size : no_boundary;
+
+    /* tail window k starts at size - (k + 1) * window_size, i.e. at rest + j * window_size with j = windows - 1 - k */
+    const qint64 rest = m_size - windows * window_size;
+    const qint64 j = (start <= rest) ? 0 : (start - rest + window_size - 1) / window_size;
+    m_first_tail = int(windows - 1 - j);
+    m_next_tail = (j < windows) ? rest + j * window_size : no_boundary;
+    updateNextBoundary();
+}
+
+void MapfileDigest::Part::updateNextBoundary()
+{
+    m_next_boundary = qMin(m_next_head, m_next_tail);
+}
+
+/*
+ * The boundaries up to the newline of the current line are on it: a head window ends
+ * after the lines before it, a tail window starts before the lines after it.
+ */
+void MapfileDigest::Part::addBoundaries(qint64 newline, int blocks_before, int blocks_after)
+{
+    const qint64 last_head = (m_size / window_size) * window_size;
+    while (m_next_head <= newline) {
+        m_head.append(Count{blocks_before, m_lines});
+        m_next_head += window_size;
+        if (m_next_head > last_head) {
+            m_next_head = no_boundary;
+        }
+    }
+    const qint64 last_tail = m_size - window_size;
+    while (m_next_tail <= newline) {
+        m_tail.append(Count{blocks_after, m_lines + 1});
+        m_next_tail += window_size;
+        if (m_next_tail > last_tail) {
+            m_next_tail = no_boundary;
+        }
+    }
+    updateNextBoundary();
+}
+
+void MapfileDigest::Part::hash()
+{
+    m_head_hashes.resize(m_head.count());
+    for (int i = 0; i < m_head.count(); ++i) {
+        m_head_hashes[i] = MapfileDigest::hash(m_section + qint64(m_first_head + i) * window_size);
+    }
+    m_tail_hashes.resize(m_tail.count());
+    for (int i = 0; i < m_tail.count(); ++i) {
+        m_tail_hashes[i] = MapfileDigest::hash(m_section + m_size - qint64(m_first_tail - i + 1) * window_size);
+    }
+}
+
+void MapfileDigest::reset(qint64 size)
+{
+    clear();
+    m_size = size;
+    const int windows = int(size / window_size);
+    m_head.fill(Window{0, -1, 0}, windows);
+    m_tail.fill(Window{0, -1, 0}, windows);
+}
+
+/*
+ * The counts of the part are offset by the block lines and lines of the section before it
+ */
+void MapfileDigest::addPart(const Part &part, int blocks_before, int lines_before)
+{
+    for (int i = 0; i < part.m_head.count(); ++i) {
+        const Part::Count &count = part.m_head.at(i);
+        m_head[part.m_first_head + i] = Window{part.m_head_hashes.at(i), blocks_before + count.blocks, lines_before + count.lines};
+    }
+    for (int i = 0; i < part.m_tail.count(); ++i) {
+        const Part::Count &count = part.m_tail.at(i);
+        m_tail[part.m_first_tail - i] = Window{part.m_tail_hashes.at(i), blocks_before + count.blocks, lines_before + count.lines};
+    }
+}
+
+/*
+ * The boundaries found by another digest of the same section, not finished yet, e.g.
+ * of the changed lines parsed on their own
+ */
+void MapfileDigest::addDigest(const MapfileDigest &other, int blocks_before, int lines_before)
+{
+    const int head_windows = qMin(m_head.count(), other.m_head.count());
+    for (int k = 0; k < head_windows; ++k) {
+        const Window &window = other.m_head.at(k);
+        if (window.blocks >= 0) {
+            m_head[k] = Window{window.hash, blocks_before + window.blocks, lines_before + window.lines};
+        }
+    }
+    const int tail_windows = qMin(m_tail.count(), other.m_tail.count());
+    for (int k = 0; k < tail_windows; ++k) {
+        const Window &window = other.m_tail.at(k);
+        if (window.blocks >= 0) {
+            m_tail[k] = Window{window.hash, blocks_before + window.blocks, lines_before + window.lines};
+        }
+    }
+}
+
+/*
+ * Copy the head and tail windows of the previous digest which are unchanged, given the
+ * block lines and lines of the new section
+ */
+void MapfileDigest::reuse(const MapfileDigest &previous, int head, int tail, int blocks, int lines)
+{
+    for (int k = 0; k < head && k < m_head.count(); ++k) {
+        m_head[k] = previous.m_head.at(k);
+    }
+    /* the counts of a finished tail window are from its start to the end */
+    for (int k = 0; k < tail && k < m_tail.count(); ++k) {
+        const Window &window = previous.m_tail.at(k);
+        m_tail[k] = Window{window.hash, blocks - window.blocks, lines - window.lines};
+    }
+}
+
+/*
+ * The digest covers the head windows, and the tail windows, up to the first one whose
+ * boundary was not found.
+ */
+void MapfileDigest::finish(const char *section, int blocks, int lines)
+{
+    m_section = QByteArray(section, int(m_size));
+    int head = 0;
+    while (head < m_head.count() && m_head.at(head).blocks >= 0) {
+        ++head;
+    }
+    m_head.resize(head);
+    int tail = 0;
+    while (tail < m_tail.count() && m_tail.at(tail).blocks >= 0) {
+        m_tail[tail].blocks = blocks - m_tail.at(tail).blocks;
+        m_tail[tail].lines = lines - m_tail.at(tail).lines;
+        ++tail;
+    }
+    m_tail.resize(tail);
+    m_valid = true;
+}
+
+/*
+ * Number of head windows of a new data section identical to this digest's.
+ */
+int MapfileDigest::unchangedHead(const char *begin, const char *end) const
+{
+    const int windows = int(qMin(qint64(m_head.count()), qint64((end - begin) / window_size)));
+    int k = 0;
+    while (k < windows && hash(begin + qint64(k) * window_size) == m_head.at(k).hash
+           && memcmp(begin + qint64(k) * window_size, m_section.constData() + qint64(k) * window_size, window_size) == 0) {
+        ++k;
+    }
+    return k;
+}
+
+/*
+ * Number of tail windows of a new data section identical to this digest's.
+ */
+int MapfileDigest::unchangedTail(const char *begin, const char *end) const
+{
+    const int windows = int(qMin(qint64(m_tail.count()), qint64((end - begin) / window_size)));
+    int k = 0;
+    const char *previous_end = m_section.constData() + m_section.size();
+    while (k < windows && hash(end - qint64(k + 1) * window_size) == m_tail.at(k).hash
+           && memcmp(end - qint64(k + 1) * window_size, previous_end - qint64(k + 1) * window_size, window_size) == 0) {
+        ++k;
+    }
+    return k;
+}
@@ -0,0 +1,137 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPFILE_DIGEST_H
+#define MAPFILE_DIGEST_H
+
+#include <QByteArray>
+#include <QVector>
+
+#include <limits>
+
+/**
+ * Checksums of the data block section of a mapfile, used to find which part of
+ * the mapfile changed since it was last parsed.
+ *
+ * The section is cut into fixed-size windows counted both from its start (head
+ * windows) and from its end (tail windows). For each window, the digest also
+ * records how many data block lines, and lines, are left untouched when the bytes
+ * up to that window (respectively from that window on) are unchanged:
+ * - head window k: the lines whose newline is before the end of the window;
+ * - tail window k: the lines starting after the beginning of the window.
+ *
+ * The digest is built while the section is parsed, without a pass of its own: each
+ * Part of the section, e.g. the chunk of a thread, records the window boundaries
+ * falling on its lines and hashes the windows of these boundaries. A digest may only
+ * cover the head and tail windows up to a point, e.g. after a parse of the changed
+ * lines only, whose unchanged head and tail windows are copied from the previous digest.
+ *
+ * A finished digest keeps a copy of the section: a window is only found unchanged when
+ * its bytes are the same, the hashes only rule out the changed windows quickly. A hash
+ * collision must not leave stale blocks on the map of a rescue watched for days.
+ */
+class MapfileDigest
+{
+public:
+    MapfileDigest();
+
+    static const int window_size = 16 * 1024;
+
+    /* the window boundaries on the lines of a part of a section, from the start of the part */
+    class Part
+    {
+    public:
+        Part();
+        Part(const char *section, const char *section_end, const char *begin);
+
+        // each line of the part in turn, to its newline (or the end of the section), and
+        // the block lines of the part before and after it
+        void addLine(const char *newline, int blocks_before, int blocks_after)
+        {
+            if (newline - m_section >= m_next_boundary) {
+                addBoundaries(newline - m_section, blocks_before, blocks_after);
+            }
+            ++m_lines;
+        }
+        void hash();  // the windows of the boundaries found, once the lines are added
+
+    private:
+        friend class MapfileDigest;
+        struct Count
+        {
+            int blocks;
+            int lines;
+        };
+
+        void addBoundaries(qint64 newline, int blocks_before, int blocks_after);
+        void updateNextBoundary();
+
+        const char *m_section;
+        qint64 m_size;  // of the section
+        int m_lines;
+        int m_first_head;  // head window of the first head boundary, the next ones follow
+        int m_first_tail;  // tail window of the first tail boundary, the next ones precede
+        QVector<Count> m_head;
+        QVector<Count> m_tail;
+        QVector<uint> m_head_hashes;
+        QVector<uint> m_tail_hashes;
+        qint64 m_next_head;  // position in the section, max() after the last one
+        qint64 m_next_tail;
+        qint64 m_next_boundary;
+    };
+
+    // building: reset() for a section of size bytes, add the parts, then finish()
+    void reset(qint64 size);
+    void addPart(const Part &part, int blocks_before, int lines_before);
+    void addDigest(const MapfileDigest &other, int blocks_before, int lines_before);  // not finished
+    void reuse(const MapfileDigest &previous, int head, int tail, int blocks, int lines);  // unchanged windows
+    void finish(const char *section, int blocks, int lines);  // copies the section
+    void clear();
+
+    bool isValid() const { return m_valid; }
+    qint64 size() const { return m_size; }
+
+    int unchangedHead(const char *begin, const char *end) const;
+    int unchangedTail(const char *begin, const char *end) const;
+    int headBlocks(int windows) const { return windows > 0 ? m_head.at(windows - 1).blocks : 0; }
+    int tailBlocks(int windows) const { return windows > 0 ? m_tail.at(windows - 1).blocks : 0; }
+    int headLines(int windows) const { return windows > 0 ? m_head.at(windows - 1).lines : 0; }
+    int tailLines(int windows) const { return windows > 0 ? m_tail.at(windows - 1).lines : 0; }
+
+private:
+    /* a window: its hash, and the lines before its boundary (after it once finished, for tail windows) */
+    struct Window
+    {
+        uint hash;
+        int blocks;  // -1 while the boundary is not found
+        int lines;
+    };
+
+    static uint hash(const char *window);
+
+    bool m_valid;
+    qint64 m_size;
+    QByteArray m_section;  // once finished, to compare the windows of the next section with
+    QVector<Window> m_head;
+    QVector<Window> m_tail;
+};
+
+#endif // MAPFILE_DIGEST_H
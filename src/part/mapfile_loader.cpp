@@ -0,0 +1,153 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mapfile_loader.h"
+
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+
+MapfileLoader::MapfileLoader(QObject *parent)
+    : QObject(parent)
+    , m_bytes_total(0)
+    , m_parser(new MapfileParser)
+    , m_watcher(nullptr)
+    , m_cache_enabled(false)
+{
+    m_progress_timer.setInterval(100);
+    connect(&m_progress_timer, &QTimer::timeout, this, &MapfileLoader::reportProgress);
+}
+
+MapfileLoader::~MapfileLoader()
+{
+    /* the worker threads must not outlive the plugin code they run */
+    cancel();
+    const auto watchers = findChildren<QFutureWatcher<bool>*>();
+    for (QFutureWatcher<bool> *watcher : watchers) {
+        watcher->waitForFinished();
+    }
+    m_cache_writer.waitForFinished();
+}
+
+void MapfileLoader::load(const QString &file_name)
+{
+    /* a superseded load ends on its own, its result is dropped in finish() */
+    cancel();
+    m_watcher = nullptr;
+
+    /* reloading the same mapfile only parses again what changed since the last successful load */
+    QSharedPointer<const MapfileParser> previous;
+    if (file_name == m_loaded_file_name) {
+        previous = m_loaded_parser;
+    }
+
+    m_file_name = file_name;
+    m_bytes_total = QFileInfo(file_name).size();
+    QSharedPointer<MapfileParser> parser(new MapfileParser);
+    parser->setIncremental(true);  // the next load of the same mapfile reuses this parse
+    /* a reload parses the changes only, which is faster than reading the cache */
+    QSharedPointer<CacheState> cache_state;
+    if (m_cache_enabled && !previous) {
+        cache_state.reset(new CacheState);
+    }
+
+    QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher]() { finish(watcher); });
+    m_watcher = watcher;
+    m_parser = parser;
+    m_cache_state = cache_state;
+    watcher->setFuture(QtConcurrent::run([parser, file_name, previous, cache_state]() {
+        if (cache_state) {
+            cache_state->keyed = MapfileCache::fileKey(file_name, &cache_state->key);
+            if (cache_state->keyed
+                && MapfileCache::read(MapfileCache::cacheFileName(file_name), cache_state->key, parser.data())) {
+                cache_state->restored = true;
+                return true;
+            }
+        }
+        return parser->parseFile(file_name, previous.data());
+    }));
+
+    m_progress_timer.start();
+    emit started(file_name);
+}
+
+bool MapfileLoader::isLoading() const
+{
+    return m_watcher != nullptr;
+}
+
+void MapfileLoader::cancel()
+{
+    if (m_watcher) {
+        m_parser->cancel();
+    }
+}
+
+void MapfileLoader::reportProgress()
+{
+    emit progress(m_parser->bytesParsed(), m_bytes_total, m_parser->blocksFound());
+}
+
+void MapfileLoader::finish(QFutureWatcher<bool> *watcher)
+{
+    watcher->deleteLater();
+    if (watcher != m_watcher) {
+        return;
+    }
+
+    m_watcher = nullptr;
+    m_progress_timer.stop();
+    reportProgress();
+
+    if (m_parser->isCanceled()) {
+        emit canceled();
+    } else if (!watcher->result()) {
+        emit failed(m_parser->errorString());
+    } else {
+        m_loaded_file_name = m_file_name;
+        m_loaded_parser = m_parser;
+        writeCache();
+        emit loaded();
+    }
+}
+
+/*
+ * Write the cache of a large mapfile which had to be parsed in full, in the background:
+ * the map is shown meanwhile. Refreshes do not rewrite it each time, and the cache is
+ * not written if the mapfile changed since it was parsed.
+ */
+void MapfileLoader::writeCache()
+{
+    const QSharedPointer<CacheState> state = m_cache_state;
+    if (!state || state->restored || !state->keyed || state->key.size < MapfileCache::min_file_size
+        || m_cache_writer.isRunning()) {
+        return;
+    }
+    const QString file_name = m_loaded_file_name;
+    const QSharedPointer<const MapfileParser> parser = m_loaded_parser;
+    m_cache_writer = QtConcurrent::run([file_name, parser, state]() {
+        MapfileCache::Key key;
+        if (MapfileCache::fileKey(file_name, &key) && key == state->key) {
+            MapfileCache::write(MapfileCache::cacheFileName(file_name), key, *parser);
+        }
+    });
+}
@@ -0,0 +1,96 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPFILE_LOADER_H
+#define MAPFILE_LOADER_H
+
+#include "mapfile_cache.h"
+#include "mapfile_parser.h"
+
+#include <QFuture>
+#include <QObject>
+#include <QSharedPointer>
+#include <QTimer>
+
+template <typename T> class QFutureWatcher;
+
+/**
+ * Load a mapfile with MapfileParser on a worker thread.
+ *
+ * Progress is reported periodically while the file is parsed. Once loaded()
+ * is emitted, the parsed map is available from parser() until the next load.
+ * Starting a new load cancels the one in progress. Loading again the last loaded
+ * mapfile only parses the lines which changed since.
+ *
+ * With the cache enabled, a mapfile opened for the first time is restored from its
+ * MapfileCache when it is current, and large mapfiles which had to be parsed in full
+ * get their cache written again in the background.
+ */
+class MapfileLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MapfileLoader(QObject *parent = nullptr);
+    ~MapfileLoader() override;
+
+    void load(const QString &file_name);
+    bool isLoading() const;
+    QString fileName() const { return m_file_name; }
+    const MapfileParser &parser() const { return *m_parser; }
+    void setCacheEnabled(bool enabled) { m_cache_enabled = enabled; }
+
+public slots:
+    void cancel();
+
+signals:
+    void started(const QString &file_name);
+    void progress(qint64 bytes_parsed, qint64 bytes_total, qint64 blocks_found);
+    void loaded();
+    void failed(const QString &error);
+    void canceled();
+
+private:
+    // written by the worker thread, read once it is finished
+    struct CacheState
+    {
+        MapfileCache::Key key;
+        bool keyed = false;
+        bool restored = false;
+    };
+
+    void reportProgress();
+    void finish(QFutureWatcher<bool> *watcher);
+    void writeCache();
+
+    QString m_file_name;
+    qint64 m_bytes_total;
+    QSharedPointer<MapfileParser> m_parser;
+    QFutureWatcher<bool> *m_watcher;
+    QString m_loaded_file_name;
+    QSharedPointer<const MapfileParser> m_loaded_parser;
+    QTimer m_progress_timer;
+    bool m_cache_enabled;
+    QSharedPointer<CacheState> m_cache_state;
+    QFuture<void> m_cache_writer;
+};
+
+#endif // MAPFILE_LOADER_H
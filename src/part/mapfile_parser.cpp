@@ -0,0 +1,632 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mapfile_parser.h"
+#include "rescue_operation.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QDebug>
+#include <QThread>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace {
+
+struct Token
+{
+    const char *begin;
+    const char *end;
+};
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+bool isOperation(const Token &t)
+{
+    return t.end - t.begin == 1 && RescueOperation::isValid(QString(QLatin1Char(*t.begin)));
+}
+
+bool isStatus(const Token &t)
+{
+    return t.end - t.begin == 1 && BlockStatus::isValid(*t.begin);
+}
+
+/*
+ * Date of a header comment such as "# Current time:  2020-03-14 15:09:26",
+ * an invalid date when the comment does not start with the given label.
+ */
+QDateTime headerTime(const char *begin, const char *end, const char *label)
+{
+    const int length = int(strlen(label));
+    if (end - begin < length || memcmp(begin, label, length) != 0) {
+        return QDateTime();
+    }
+    const QString time = QString::fromLatin1(begin + length, int(end - begin - length)).trimmed();
+    return QDateTime::fromString(time, QStringLiteral("yyyy-MM-dd hh:mm:ss"));
+}
+
+}
+
+
+MapfileParser::MapfileParser()
+    : m_line_count(0)
+    , m_header_lines(0)
+    , m_reused_blocks(0)
+    , m_discontinuity(-1)
+    , m_parallel(true)
+    , m_incremental(false)
+    , m_progress(new Progress)
+{
+}
+
+void MapfileParser::clear()
+{
+    m_blocks.clear();
+    m_rescue_status = RescueStatus();
+    m_line_count = 0;
+    m_header_lines = 0;
+    m_reused_blocks = 0;
+    m_digest.clear();
+    m_discontinuity = -1;
+    m_error.clear();
+    m_error_line.clear();
+    m_progress->bytes.store(0);
+    m_progress->blocks.store(0);
+}
+
+/*
+ * Convert a non-negative integer written in the mapfile.
+ * Base 0 guesses the base as QString::toLongLong() does: hexadecimal with a 0x prefix,
+ * octal with a leading 0 and decimal otherwise. Base 10 is used for the pass number.
+ */
+bool MapfileParser::toInteger(const char *p, const char *end, int base, qint64 *value)
+{
+    if (p != end && *p == '+') {
+        ++p;
+    }
+    if (p == end) {
+        return false;
+    }
+    if (base == 0) {
+        if (*p == '0' && end - p > 1 && (p[1] == 'x' || p[1] == 'X')) {
+            base = 16;
+            p += 2;
+            if (p == end) {
+                return false;
+            }
+        } else if (*p == '0') {
+            base = 8;
+        } else {
+            base = 10;
+        }
+    }
+
+    quint64 result = 0;
+    for (; p != end; ++p) {
+        const char c = *p;
+        int digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            return false;
+        }
+        if (digit >= base) {
+            return false;
+        }
+        if (result > (quint64(LLONG_MAX) - digit) / base) {
+            return false;  /* overflow */
+        }
+        result = result * base + digit;
+    }
+    *value = qint64(result);
+    return true;
+}
+
+/*
+ * Parse a GNU ddrescue map file
+ * Map file structure is described at https://www.gnu.org/software/ddrescue/manual/ddrescue_manual.html#Mapfile-structure
+ */
+bool MapfileParser::parseFile(const QString &file_name, const MapfileParser *previous)
+{
+    clear();
+
+    QFile file(file_name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_error = file.errorString();
+        return false;
+    }
+
+    const qint64 file_size = file.size();
+    if (file_size == 0) {
+        return true;
+    }
+
+    uchar *data = file.map(0, file_size);
+    if (data) {
+        const char *begin = reinterpret_cast<const char*>(data);
+        const bool ok = parse(begin, begin + file_size, previous);
+        file.unmap(data);
+        return ok;
+    }
+
+    /* the file cannot be mapped (e.g. a pipe), read it at once instead */
+    const QByteArray content = file.readAll();
+    return parse(content.constData(), content.constData() + content.size(), previous);
+}
+
+/*
+ * Parse a mapfile. When the previous parse of the same mapfile is given, only the data
+ * block lines which changed since then are parsed again.
+ */
+bool MapfileParser::parse(const char *begin, const char *end, const MapfileParser *previous)
+{
+    clear();
+
+    /* the comment lines and the status line at the top are parsed sequentially */
+    const char *line = begin;
+    while (line < end && !m_rescue_status.currentOperation().isValid() && m_blocks.isEmpty()) {
+        const char *eol = static_cast<const char*>(memchr(line, '\n', end - line));
+        if (!eol) {
+            eol = end;
+        }
+        ++m_line_count;
+        if (!parseLine(line, eol)) {
+            return false;
+        }
+        line = eol + 1;
+    }
+    m_progress->bytes.fetchAndAddRelaxed(qMin(line, end) - begin);
+    if (line >= end) {
+        return true;
+    }
+
+    /* the data block section follows the status line */
+    const bool data_section = m_blocks.isEmpty();
+    m_header_lines = m_line_count;
+    if (data_section && m_incremental) {
+        m_digest.reset(end - line);
+    }
+    if (!data_section || !previous || !reparse(line, end, *previous)) {
+        if (isCanceled() || !parseData(line, end, line, end)) {
+            return false;
+        }
+    }
+    if (data_section && m_incremental) {
+        m_digest.finish(line, m_blocks.count(), int(m_line_count - m_header_lines));
+    }
+    return true;
+}
+
+/*
+ * Take the result of a former parse of the same file. There is no digest: the next
+ * parse given this one as previous parses the whole file.
+ */
+void MapfileParser::restore(const BlockTable &blocks, const RescueStatus &status)
+{
+    clear();
+    m_blocks = blocks;
+    m_rescue_status = status;
+    m_progress->blocks.store(blocks.count());
+}
+
+/*
+ * Parse the data block lines from begin to end, in the data block section from section
+ * to section_end
+ */
+bool MapfileParser::parseData(const char *section, const char *section_end, const char *begin, const char *end)
+{
+    /* the data block lines can be split among several threads */
+    const int chunks = m_parallel ? chunkCount(end - begin) : 1;
+    if (chunks > 1) {
+        return parseChunks(section, section_end, begin, end, chunks);
+    }
+    if (!m_incremental) {
+        return parseLines(begin, end);
+    }
+    MapfileDigest::Part part(section, section_end, begin);
+    const int blocks_before = m_blocks.count();
+    const int lines_before = int(m_line_count - m_header_lines);
+    if (!parseLines(begin, end, &part)) {
+        return false;
+    }
+    part.hash();
+    m_digest.addPart(part, blocks_before, lines_before);
+    return true;
+}
+
+/*
+ * Parse only the data block lines between the unchanged head and tail of the data block
+ * section, as found by the digest of the previous parse, and splice them with the blocks
+ * of the previous parse. Returns false, with no block parsed, when the whole section has
+ * to be parsed instead.
+ */
+bool MapfileParser::reparse(const char *begin, const char *end, const MapfileParser &previous)
+{
+    const MapfileDigest &digest = previous.m_digest;
+    if (!digest.isValid()) {
+        return false;
+    }
+
+    const qint64 window_size = MapfileDigest::window_size;
+    const int head = digest.unchangedHead(begin, end);
+    int tail = digest.unchangedTail(begin, end);
+    /* the unchanged head and tail must not overlap, neither in the previous nor in the new section */
+    const qint64 shortest = qMin(qint64(end - begin), digest.size());
+    if ((head + tail) * window_size > shortest) {
+        tail = int(shortest / window_size) - head;
+    }
+    const int head_blocks = digest.headBlocks(head);
+    const int tail_blocks = digest.tailBlocks(tail);
+    const int previous_blocks = previous.m_blocks.count();
+    if (head_blocks + tail_blocks > previous_blocks) {
+        return false;
+    }
+
+    /* the changed lines start after the last newline of the unchanged head... */
+    const char *middle_begin = begin + head * window_size;
+    while (middle_begin > begin && middle_begin[-1] != '\n') {
+        --middle_begin;
+    }
+    /* ...and end with the first newline of the unchanged tail */
+    const char *middle_end = end;
+    if (tail > 0) {
+        const char *tail_begin = end - tail * window_size;
+        const char *eol = static_cast<const char*>(memchr(tail_begin, '\n', end - tail_begin));
+        middle_end = eol ? eol + 1 : end;
+    }
+
+    /* the full parse which follows a failure counts the bytes and the blocks again */
+    const qint64 bytes_before = m_progress->bytes.load();
+    const qint64 blocks_before = m_progress->blocks.load();
+    auto resetProgress = [&]() {
+        m_progress->bytes.store(bytes_before);
+        m_progress->blocks.store(blocks_before);
+    };
+
+    MapfileParser middle;
+    middle.m_rescue_status = m_rescue_status;
+    middle.m_progress = m_progress;
+    middle.m_parallel = m_parallel;
+    middle.m_incremental = m_incremental;
+    if (m_incremental) {
+        middle.m_digest.reset(end - begin);
+    }
+    m_progress->bytes.fetchAndAddRelaxed((middle_begin - begin) + (end - middle_end));
+    m_progress->blocks.fetchAndAddRelaxed(head_blocks + tail_blocks);
+    if (!middle.parseData(begin, end, middle_begin, middle_end)) {
+        resetProgress();
+        return false;  /* errors are reported by the full parse, with their line number */
+    }
+
+    /* the blocks must still be contiguous at the seams between the reused blocks and the parsed ones */
+    m_blocks.reserve(head_blocks + middle.m_blocks.count() + tail_blocks);
+    if (!m_blocks.append(previous.m_blocks, 0, head_blocks)
+        || !m_blocks.append(middle.m_blocks)
+        || !m_blocks.append(previous.m_blocks, previous_blocks - tail_blocks, tail_blocks))
+    {
+        m_blocks.clear();
+        resetProgress();
+        return false;
+    }
+    const int head_lines = digest.headLines(head);
+    const int middle_lines = int(middle.m_line_count);
+    const int tail_lines = digest.tailLines(tail);
+    m_line_count += head_lines + middle_lines + tail_lines;
+    m_reused_blocks = head_blocks + tail_blocks;
+
+    /* the windows of the changed lines were found while parsing them, the others are unchanged */
+    if (m_incremental) {
+        m_digest.addDigest(middle.m_digest, head_blocks, head_lines);
+        m_digest.reuse(digest, head, tail, m_blocks.count(), head_lines + middle_lines + tail_lines);
+    }
+    return true;
+}
+
+/*
+ * Parse the lines from begin to end, and find the window boundaries of the digest part on them
+ */
+bool MapfileParser::parseLines(const char *begin, const char *end, MapfileDigest::Part *digest_part)
+{
+    /* progress is published, and cancellation polled, every progress_interval lines */
+    const int progress_interval = 1 << 16;
+    int countdown = progress_interval;
+    const char *reported_line = begin;
+    int reported_blocks = m_blocks.count();
+
+    for (const char *line = begin; line < end; ) {
+        const char *eol = static_cast<const char*>(memchr(line, '\n', end - line));
+        if (!eol) {
+            eol = end;
+        }
+        ++m_line_count;
+        const int blocks = m_blocks.count();
+        if (!parseLine(line, eol)) {
+            return false;
+        }
+        if (digest_part) {
+            digest_part->addLine(eol, blocks, m_blocks.count());
+        }
+        line = eol + 1;
+
+        if (--countdown == 0) {
+            countdown = progress_interval;
+            m_progress->bytes.fetchAndAddRelaxed(line - reported_line);
+            m_progress->blocks.fetchAndAddRelaxed(m_blocks.count() - reported_blocks);
+            reported_line = line;
+            reported_blocks = m_blocks.count();
+            if (isCanceled()) {
+                m_error = QStringLiteral("Parsing canceled");
+                return false;
+            }
+        }
+    }
+    m_progress->bytes.fetchAndAddRelaxed(end - reported_line);
+    m_progress->blocks.fetchAndAddRelaxed(m_blocks.count() - reported_blocks);
+    return true;
+}
+
+qint64 MapfileParser::bytesParsed() const
+{
+    return m_progress->bytes.load();
+}
+
+qint64 MapfileParser::blocksFound() const
+{
+    return m_progress->blocks.load();
+}
+
+void MapfileParser::cancel()
+{
+    m_progress->canceled.store(1);
+}
+
+bool MapfileParser::isCanceled() const
+{
+    return m_progress->canceled.load();
+}
+
+/*
+ * Chunks of at least 1 MiB, at most one per core: smaller maps are not worth a thread.
+ */
+int MapfileParser::chunkCount(qint64 bytes)
+{
+    const qint64 min_chunk_size = 1 << 20;
+    return int(qBound(qint64(1), bytes / min_chunk_size, qint64(QThread::idealThreadCount())));
+}
+
+struct MapfileParser::Chunk
+{
+    const char *begin;
+    const char *end;
+    MapfileParser parser;
+    MapfileDigest::Part digest_part;
+    bool ok;
+};
+
+/*
+ * Split the data block lines at newline boundaries, parse each chunk in its own thread
+ * and stitch the blocks together. Each chunk checks its own contiguity while parsing;
+ * the seams between chunks are checked while stitching.
+ */
+bool MapfileParser::parseChunks(const char *section, const char *section_end, const char *begin, const char *end, int count)
+{
+    QVector<Chunk> chunks;
+    chunks.reserve(count);
+    const qint64 chunk_size = (end - begin) / count;
+    const char *chunk_begin = begin;
+    for (int i = 0; i < count && chunk_begin < end; ++i) {
+        const char *chunk_end = end;
+        if (i + 1 < count && chunk_begin + chunk_size < end) {
+            const char *eol = static_cast<const char*>(memchr(chunk_begin + chunk_size, '\n', end - chunk_begin - chunk_size));
+            chunk_end = eol ? eol + 1 : end;
+        }
+        Chunk chunk;
+        chunk.begin = chunk_begin;
+        chunk.end = chunk_end;
+        chunk.parser.m_rescue_status = m_rescue_status;  /* status already found: only data blocks remain */
+        chunk.parser.m_progress = m_progress;  /* chunks report to and are canceled with this parser */
+        if (m_incremental) {
+            chunk.digest_part = MapfileDigest::Part(section, section_end, chunk_begin);
+        }
+        chunk.ok = false;
+        chunks.append(chunk);
+        chunk_begin = chunk_end;
+    }
+
+    /* each chunk also hashes the digest windows whose boundaries are on its lines */
+    const bool incremental = m_incremental;
+    QtConcurrent::blockingMap(chunks, [incremental](Chunk &chunk) {
+        chunk.ok = chunk.parser.parseLines(chunk.begin, chunk.end, incremental ? &chunk.digest_part : nullptr);
+        if (chunk.ok && incremental) {
+            chunk.digest_part.hash();
+        }
+    });
+
+    if (isCanceled()) {
+        m_error = QStringLiteral("Parsing canceled");
+        return false;
+    }
+
+    int block_count = 0;
+    for (const Chunk &chunk : chunks) {
+        if (!chunk.ok) {
+            /* report the line and block numbers in the whole file, not in the chunk */
+            m_line_count += std::count(begin, chunk.begin, '\n') + chunk.parser.m_line_count;
+            if (chunk.parser.m_discontinuity >= 0) {
+                m_discontinuity = block_count + chunk.parser.m_discontinuity;
+                m_error = contiguityErrorString(m_discontinuity);
+                return false;
+            }
+            return lineError(chunk.parser.m_error_line);
+        }
+        block_count += chunk.parser.m_blocks.count();
+    }
+
+    m_blocks.reserve(block_count);
+    for (const Chunk &chunk : chunks) {
+        if (m_incremental) {
+            m_digest.addPart(chunk.digest_part, m_blocks.count(), int(m_line_count - m_header_lines));
+        }
+        /* the seam between the previous chunk and this one */
+        if (!chunk.parser.m_blocks.isEmpty() && !m_blocks.append(chunk.parser.m_blocks)) {
+            return contiguityError(chunk.parser.m_blocks.position(0).data());
+        }
+        m_line_count += chunk.parser.m_line_count;
+    }
+    return true;
+}
+
+bool MapfileParser::parseLine(const char *begin, const char *end)
+{
+    while (begin < end && isSpace(*begin)) {
+        ++begin;
+    }
+    while (begin < end && isSpace(end[-1])) {
+        --end;
+    }
+
+    if (begin == end) {
+        return true;
+    }
+
+    if (*begin == '#') {
+        /* comment line, only the times of the header are kept */
+        /* TODO: parse comment lines with ddrescue_version, human_readable_status */
+        if (!m_rescue_status.currentOperation().isValid()) {
+            ++begin;
+            while (begin < end && isSpace(*begin)) {
+                ++begin;
+            }
+            const QDateTime start_time = headerTime(begin, end, "Start time:");
+            if (start_time.isValid()) {
+                m_rescue_status.setStartTime(start_time);
+            }
+            const QDateTime current_time = headerTime(begin, end, "Current time:");
+            if (current_time.isValid()) {
+                m_rescue_status.setCurrentTime(current_time);
+            }
+        }
+        return true;
+    }
+
+    /* Non-comment lines can be:
+     *  - The former status line with two tokens: current_pos current_status
+     *  - The new status line with three tokens: current_pos current_status current_pass
+     *  - A block information with three tokens: pos size status
+     * Any of them can be followed by a comment. Only the first four tokens are needed
+     * to tell the patterns apart.
+     */
+    Token tokens[4];
+    int count = 0;
+    for (const char *p = begin; p < end && count < 4; ) {
+        tokens[count].begin = p;
+        while (p < end && !isSpace(*p)) {
+            ++p;
+        }
+        tokens[count].end = p;
+        ++count;
+        while (p < end && isSpace(*p)) {
+            ++p;
+        }
+    }
+
+    const bool two_tokens = count == 2 || (count > 2 && *tokens[2].begin == '#');
+    const bool three_tokens = count == 3 || (count > 3 && *tokens[3].begin == '#');
+    qint64 position;
+    qint64 size;
+    qint64 pass;
+
+    if (!m_rescue_status.currentOperation().isValid()) {
+        /* former status line pattern: (quint64 current_position) (char current_operation) (optional comment) */
+        if (two_tokens
+            && toInteger(tokens[0].begin, tokens[0].end, 0, &position)
+            && isOperation(tokens[1]))
+        {
+            m_rescue_status.setCurrentPosition(position);
+            m_rescue_status.setCurrentOperation(QString(QLatin1Char(*tokens[1].begin)));
+            return true;
+        }
+
+        /* status line pattern: (qint64 current_position) (char current_operation) (int current_pass) (optional comment) */
+        if (three_tokens
+            && toInteger(tokens[0].begin, tokens[0].end, 0, &position)
+            && isOperation(tokens[1])
+            && toInteger(tokens[2].begin, tokens[2].end, 10, &pass)  /* 10: pass number must be in base 10 */
+            && pass >= 1 && pass <= INT_MAX)
+        {
+            m_rescue_status.setCurrentPosition(position);
+            m_rescue_status.setCurrentOperation(QString(QLatin1Char(*tokens[1].begin)));
+            m_rescue_status.setCurrentPass(int(pass));
+            return true;
+        }
+    }
+
+    /* block information pattern: (qint64 position) (qint64 size) (char status) (optional comment) */
+    if (three_tokens
+        && toInteger(tokens[0].begin, tokens[0].end, 0, &position)
+        && toInteger(tokens[1].begin, tokens[1].end, 0, &size)
+        && size > 0
+        && isStatus(tokens[2]))
+    {
+        if (!m_blocks.append(position, size, BlockStatus::toCode(*tokens[2].begin))) {
+            return contiguityError(position);
+        }
+        return true;
+    }
+
+    return lineError(QString::fromLatin1(begin, int(end - begin)));
+}
+
+bool MapfileParser::lineError(const QString &line)
+{
+    m_error_line = line;
+    m_error = QStringLiteral("Parsing error: line %1 does not match a status or block information pattern: %2")
+        .arg(m_line_count)
+        .arg(line);
+    return false;
+}
+
+/*
+ * The next block, starting at next_position, does not start where the last block ends.
+ */
+bool MapfileParser::contiguityError(qint64 next_position)
+{
+    m_discontinuity = m_blocks.count() - 1;
+    qDebug() << "Error, next block not contiguous!";
+    qDebug() << m_blocks.position(m_discontinuity) << " + " << m_blocks.size(m_discontinuity) << " =! " << BlockPosition(next_position);
+    m_error = contiguityErrorString(m_discontinuity);
+    return false;
+}
+
+QString MapfileParser::contiguityErrorString(int row)
+{
+    return QStringLiteral("Parsing error: block %1 is not contiguous with the next block").arg(row);
+}
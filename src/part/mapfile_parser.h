@@ -0,0 +1,112 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPFILE_PARSER_H
+#define MAPFILE_PARSER_H
+
+#include "block_table.h"
+#include "mapfile_digest.h"
+#include "rescue_status.h"
+
+#include <QAtomicInteger>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+/**
+ * Parser for GNU ddrescue mapfiles working on the raw bytes of the file.
+ *
+ * The file is memory-mapped and tokenized in place: no QString is built for a
+ * line or a token, and numbers are converted straight from the bytes with the
+ * same rules as QString::toLongLong(&ok, 0) (0x prefix for hexadecimal, leading
+ * 0 for octal, decimal otherwise).
+ *
+ * In parallel mode (the default), the data block lines of large mapfiles are split
+ * at newline boundaries into one chunk per core and the chunks are parsed concurrently.
+ *
+ * When the previous parse of the same mapfile is given, only the data block lines
+ * between the unchanged head and tail of the file (found with a MapfileDigest) are
+ * parsed again, the other blocks are copied from the previous parse. The digest is
+ * only built, while parsing, by the parsers set incremental, e.g. by MapfileLoader:
+ * a parse which is never given as previous has no use for it.
+ *
+ * The progress getters and cancel() can be called from another thread while parsing.
+ * cf. https://www.gnu.org/software/ddrescue/manual/ddrescue_manual.html#Mapfile-structure
+ */
+class MapfileParser
+{
+public:
+    MapfileParser();
+
+    bool parseFile(const QString &file_name, const MapfileParser *previous = nullptr);
+    bool parse(const char *begin, const char *end, const MapfileParser *previous = nullptr);
+    void setParallel(bool parallel) { m_parallel = parallel; }
+    void setIncremental(bool incremental) { m_incremental = incremental; }  // for a next parse given this one as previous
+    void restore(const BlockTable &blocks, const RescueStatus &status);  // without parsing, e.g. from a MapfileCache
+
+    const BlockTable &blocks() const { return m_blocks; }
+    RescueStatus rescueStatus() const { return m_rescue_status; }
+    qint64 lineCount() const { return m_line_count; }
+    int reusedBlocks() const { return m_reused_blocks; }
+    QString errorString() const { return m_error; }
+
+    qint64 bytesParsed() const;
+    qint64 blocksFound() const;
+    void cancel();
+    bool isCanceled() const;
+
+    static bool toInteger(const char *begin, const char *end, int base, qint64 *value);
+
+private:
+    struct Chunk;
+    struct Progress
+    {
+        QAtomicInteger<qint64> bytes;
+        QAtomicInteger<qint64> blocks;
+        QAtomicInt canceled;
+    };
+
+    bool parseData(const char *section, const char *section_end, const char *begin, const char *end);
+    bool reparse(const char *begin, const char *end, const MapfileParser &previous);
+    bool parseLines(const char *begin, const char *end, MapfileDigest::Part *digest_part = nullptr);
+    bool parseLine(const char *begin, const char *end);
+    bool parseChunks(const char *section, const char *section_end, const char *begin, const char *end, int count);
+    static int chunkCount(qint64 bytes);
+    bool contiguityError(qint64 next_position);
+    static QString contiguityErrorString(int row);
+    bool lineError(const QString &line);
+    void clear();
+
+    BlockTable m_blocks;
+    RescueStatus m_rescue_status;
+    qint64 m_line_count;
+    qint64 m_header_lines;  // before the data block section
+    int m_reused_blocks;
+    int m_discontinuity;
+    MapfileDigest m_digest;
+    QString m_error;
+    QString m_error_line;
+    bool m_parallel;
+    bool m_incremental;
+    QSharedPointer<Progress> m_progress;  // shared with the chunk parsers
+};
+
+#endif // MAPFILE_PARSER_H
@@ -0,0 +1,163 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mapfile_writer.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QSaveFile>
+
+namespace {
+
+const int buffer_size = 1 << 16;
+
+/* "0x" and at least 8 upper case hexadecimal digits, as ddrescue writes positions */
+char *putHex(char *p, qint64 value)
+{
+    char digits[16];
+    int count = 0;
+    quint64 v = quint64(value);
+    do {
+        digits[count++] = "0123456789ABCDEF"[v & 15];
+        v >>= 4;
+    } while (v);
+    while (count < 8) {
+        digits[count++] = '0';
+    }
+    *p++ = '0';
+    *p++ = 'x';
+    while (count > 0) {
+        *p++ = digits[--count];
+    }
+    return p;
+}
+
+QByteArray headerTime(const char *label, const QDateTime &time)
+{
+    return QByteArray(label) + time.toString(QStringLiteral("yyyy-MM-dd hh:mm:ss")).toLatin1() + '\n';
+}
+
+}
+
+
+MapfileWriter::MapfileWriter()
+    : m_device(nullptr)
+    , m_ok(false)
+{
+}
+
+/*
+ * Start a mapfile on device with the comment header and the status line
+ */
+bool MapfileWriter::begin(QIODevice *device)
+{
+    m_device = device;
+    m_ok = true;
+    m_error.clear();
+
+    m_buffer = QByteArray("# Mapfile. Created by kddrescueview\n");
+    m_buffer.reserve(buffer_size + 64);
+    for (const QString &comment : m_comments) {
+        m_buffer += "# " + comment.toUtf8() + '\n';
+    }
+    if (m_rescue_status.startTime().isValid()) {
+        m_buffer += headerTime("# Start time:   ", m_rescue_status.startTime());
+    }
+    if (m_rescue_status.currentTime().isValid()) {
+        m_buffer += headerTime("# Current time: ", m_rescue_status.currentTime());
+    }
+
+    /* a map without status line, e.g. a merge, is written as a finished rescue */
+    const QString operation = m_rescue_status.currentOperation().isValid() ? m_rescue_status.currentOperation().data() : QStringLiteral("+");
+    const int pass = m_rescue_status.currentPass() > 0 ? m_rescue_status.currentPass() : 1;
+    const qint64 position = qMax(m_rescue_status.currentPosition().data(), qint64(0));
+    char line[64];
+    char *p = putHex(line, position);
+    p += snprintf(p, sizeof(line) - (p - line), "     %c               %d\n", operation.at(0).toLatin1(), pass);
+    m_buffer += "# current_pos  current_status  current_pass\n";
+    m_buffer.append(line, int(p - line));
+    m_buffer += "#      pos        size  status\n";
+    return true;
+}
+
+bool MapfileWriter::append(qint64 position, qint64 size, BlockStatus::Code status)
+{
+    char line[64];
+    char *p = putHex(line, position);
+    *p++ = ' ';
+    *p++ = ' ';
+    p = putHex(p, size);
+    *p++ = ' ';
+    *p++ = ' ';
+    *p++ = BlockStatus::toChar(status == BlockStatus::Unknown ? BlockStatus::NonTried : status);
+    *p++ = '\n';
+    m_buffer.append(line, int(p - line));
+    return m_buffer.size() < buffer_size || flush();
+}
+
+bool MapfileWriter::finish()
+{
+    const bool ok = flush();
+    m_device = nullptr;
+    m_buffer.clear();
+    return ok;
+}
+
+bool MapfileWriter::flush()
+{
+    if (m_ok && m_device->write(m_buffer) != m_buffer.size()) {
+        m_error = m_device->errorString();
+        m_ok = false;
+    }
+    m_buffer.resize(0);  // keeps the reserved capacity
+    return m_ok;
+}
+
+bool MapfileWriter::write(const BlockTable &blocks, QIODevice *device)
+{
+    begin(device);
+    const qint64 *starts = blocks.starts();
+    const quint8 *statuses = blocks.statuses();
+    for (int i = 0; i < blocks.count(); ++i) {
+        if (!append(starts[i], starts[i + 1] - starts[i], BlockStatus::Code(statuses[i]))) {
+            break;
+        }
+    }
+    return finish();
+}
+
+bool MapfileWriter::write(const BlockTable &blocks, const QString &file_name)
+{
+    QSaveFile file(file_name);
+    if (!file.open(QIODevice::WriteOnly)) {
+        m_error = file.errorString();
+        return false;
+    }
+    if (!write(blocks, &file)) {
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit()) {
+        m_error = file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,74 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPFILE_WRITER_H
+#define MAPFILE_WRITER_H
+
+#include "block_table.h"
+#include "rescue_status.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+class QIODevice;
+
+/**
+ * Writer of GNU ddrescue mapfiles, with the layout of the mapfiles of ddrescue itself
+ * so that they can be given back to ddrescue or ddrescuelog: a comment header, the
+ * status line, then one line per data block with hexadecimal position and size.
+ *
+ * Blocks can be streamed in position order between begin() and finish(), e.g. while
+ * sweeping a map, or a whole table written at once. The lines are formatted without
+ * QString into a buffer written every 64 KiB. A file is only replaced once it is
+ * completely written. Unknown statuses, which cannot be written, are written as
+ * non-tried.
+ * cf. https://www.gnu.org/software/ddrescue/manual/ddrescue_manual.html#Mapfile-structure
+ */
+class MapfileWriter
+{
+public:
+    MapfileWriter();
+
+    void setRescueStatus(const RescueStatus &status) { m_rescue_status = status; }
+    void setComments(const QStringList &comments) { m_comments = comments; }  // header lines, without '#'
+
+    // streaming: the header, the blocks in position order, then the end of the buffer
+    bool begin(QIODevice *device);
+    bool append(qint64 position, qint64 size, BlockStatus::Code status);
+    bool finish();
+
+    bool write(const BlockTable &blocks, QIODevice *device);
+    bool write(const BlockTable &blocks, const QString &file_name);
+    QString errorString() const { return m_error; }
+
+private:
+    bool flush();
+
+    RescueStatus m_rescue_status;
+    QStringList m_comments;
+    QIODevice *m_device;
+    QByteArray m_buffer;
+    bool m_ok;  // false after a write error, until the next begin()
+    QString m_error;
+};
+
+#endif // MAPFILE_WRITER_H
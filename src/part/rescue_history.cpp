@@ -0,0 +1,362 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rescue_history.h"
+#include "mapfile_cache.h"
+#include "rescue_status.h"
+#include "rescue_totals.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace {
+
+const char magic[] = "KDDVHIS";  // followed by the format version
+const char version = 1;
+const int header_size = int(sizeof(magic));
+
+const int field_count = 4 + BlockStatus::code_count;
+
+void fields(const RescueHistory::Record &record, qint64 *values)
+{
+    values[0] = record.time;
+    values[1] = record.position;
+    values[2] = record.pass;
+    values[3] = record.operation;
+    for (int status = 0; status < BlockStatus::code_count; ++status) {
+        values[4 + status] = record.bytes[status];
+    }
+}
+
+RescueHistory::Record fromFields(const qint64 *values)
+{
+    RescueHistory::Record record;
+    record.time = values[0];
+    record.position = values[1];
+    record.pass = values[2];
+    record.operation = values[3];
+    for (int status = 0; status < BlockStatus::code_count; ++status) {
+        record.bytes[status] = values[4 + status];
+    }
+    return record;
+}
+
+/* zigzag varint: small differences of either sign take a single byte */
+void putVarint(QByteArray *data, qint64 value)
+{
+    quint64 v = (quint64(value) << 1) ^ quint64(value >> 63);
+    while (v >= 0x80) {
+        data->append(char(v | 0x80));
+        v >>= 7;
+    }
+    data->append(char(v));
+}
+
+bool getVarint(const char **p, const char *end, qint64 *value)
+{
+    quint64 v = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        const quint8 byte = quint8(*(*p)++);
+        v |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = qint64(v >> 1) ^ -qint64(v & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* appends record as the differences with previous, or with zeros for the first record */
+void encode(const RescueHistory::Record *previous, const RescueHistory::Record &record, QByteArray *data)
+{
+    qint64 before[field_count] = {};
+    qint64 after[field_count];
+    if (previous) {
+        fields(*previous, before);
+    }
+    fields(record, after);
+    for (int i = 0; i < field_count; ++i) {
+        putVarint(data, after[i] - before[i]);
+    }
+}
+
+bool decode(const char **p, const char *end, const RescueHistory::Record *previous, RescueHistory::Record *record)
+{
+    qint64 values[field_count] = {};
+    if (previous) {
+        fields(*previous, values);
+    }
+    for (int i = 0; i < field_count; ++i) {
+        qint64 delta;
+        if (!getVarint(p, end, &delta)) {
+            return false;
+        }
+        values[i] += delta;
+    }
+    *record = fromFields(values);
+    return true;
+}
+
+qint64 domainSize(const RescueHistory::Record &record)
+{
+    qint64 size = 0;
+    for (int status = 0; status < BlockStatus::code_count; ++status) {
+        size += record.bytes[status];
+    }
+    return size;
+}
+
+}
+
+
+RescueHistory::RescueHistory(int capacity)
+    : m_capacity(qMax(capacity, 2))
+    , m_synced(false)
+{
+}
+
+/*
+ * Read the records kept so far in file_name, the file to which the next records are
+ * appended. A missing file is an empty history, a damaged file is rewritten at the
+ * next append with the records read before the damage.
+ */
+bool RescueHistory::open(const QString &file_name)
+{
+    m_records.clear();
+    m_file_name = file_name;
+    m_synced = false;
+    m_error.clear();
+
+    QFile file(file_name);
+    if (!file.exists()) {
+        return true;
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_error = file.errorString();
+        qDebug() << "Cannot read history" << file_name << ":" << m_error;
+        return false;
+    }
+
+    const QByteArray data = file.readAll();
+    const char *p = data.constData();
+    const char *end = p + data.size();
+    if (data.size() < header_size || memcmp(p, magic, header_size - 1) != 0 || p[header_size - 1] != version) {
+        m_error = QStringLiteral("Not a history file of this version");
+        qDebug() << "Ignoring history" << file_name << ":" << m_error;
+        return false;
+    }
+    p += header_size;
+
+    Record record;
+    while (p < end && decode(&p, end, m_records.isEmpty() ? nullptr : &m_records.last(), &record)) {
+        m_records.append(record);
+    }
+    m_synced = p == end;
+    if (!m_synced) {
+        qDebug() << "History" << file_name << "truncated after" << m_records.count() << "records";
+    }
+    return true;
+}
+
+/*
+ * Add the snapshot of a refresh, only writing its record at the end of the file.
+ * Returns false if the file cannot be written, the record being kept in memory.
+ */
+bool RescueHistory::append(const Record &record)
+{
+    if (!m_records.isEmpty()) {
+        if (record.time <= m_records.last().time) {
+            return true;
+        }
+        if (domainSize(record) != domainSize(m_records.last())) {
+            m_records.clear();
+            m_synced = false;
+        }
+    }
+
+    QByteArray data;
+    encode(m_records.isEmpty() ? nullptr : &m_records.last(), record, &data);
+    m_records.append(record);
+
+    /* drop the oldest half at once, so that the file is rewritten once per capacity records */
+    if (m_records.count() >= 2 * m_capacity) {
+        m_records.remove(0, m_records.count() - m_capacity);
+        m_synced = false;
+    }
+
+    if (m_file_name.isEmpty()) {
+        return true;
+    }
+    if (!m_synced) {
+        return save();
+    }
+
+    QFile file(m_file_name);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append) || file.write(data) != data.size()) {
+        m_error = file.errorString();
+        m_synced = false;
+        qDebug() << "Cannot append to history" << m_file_name << ":" << m_error;
+        return false;
+    }
+    return true;
+}
+
+void RescueHistory::clear()
+{
+    m_records.clear();
+    m_synced = false;
+    if (!m_file_name.isEmpty()) {
+        QFile::remove(m_file_name);
+    }
+}
+
+/*
+ * Write the whole history, replacing the file only once it is complete
+ */
+bool RescueHistory::save()
+{
+    QDir().mkpath(QFileInfo(m_file_name).absolutePath());
+    QSaveFile file(m_file_name);
+    if (!file.open(QIODevice::WriteOnly)) {
+        m_error = file.errorString();
+        qDebug() << "Cannot write history" << m_file_name << ":" << m_error;
+        return false;
+    }
+
+    QByteArray data(magic, header_size - 1);
+    data.append(version);
+    for (int i = 0; i < m_records.count(); ++i) {
+        encode(i == 0 ? nullptr : &m_records[i - 1], m_records[i], &data);
+    }
+    if (file.write(data) != data.size() || !file.commit()) {
+        m_error = file.errorString();
+        qDebug() << "Cannot write history" << m_file_name << ":" << m_error;
+        return false;
+    }
+    m_synced = true;
+    return true;
+}
+
+/* static method */
+RescueHistory::Record RescueHistory::capture(qint64 time, const RescueStatus &status, const RescueTotals &totals)
+{
+    Record record;
+    record.time = time;
+    record.position = status.currentPosition().data();
+    record.pass = status.currentPass();
+    const QString operation = status.currentOperation().data();
+    record.operation = operation.isEmpty() ? 0 : operation.at(0).toLatin1();
+    for (int status_code = 0; status_code < BlockStatus::code_count; ++status_code) {
+        record.bytes[status_code] = totals.total(BlockStatus::Code(status_code)).data();
+    }
+    return record;
+}
+
+/* static method */
+QString RescueHistory::cacheFileName(const QString &mapfile_name)
+{
+    return MapfileCache::cachePath(mapfile_name, QStringLiteral("history"), QStringLiteral(".history"));
+}
+
+/* static method */
+BlockStatus::Code RescueHistory::passStatus(qint64 operation)
+{
+    switch (operation) {
+    case '?': return BlockStatus::NonTried;
+    case '*': return BlockStatus::NonTrimmed;
+    case '/': return BlockStatus::NonScraped;
+    case '-': return BlockStatus::BadSector;
+    default: return BlockStatus::Unknown;  // finished, filling or generating
+    }
+}
+
+/*
+ * The oldest record within window of the last one, at least the one before the last.
+ * With same_pass, the records of former operations or passes are left out.
+ */
+int RescueHistory::windowStart(qint64 window, bool same_pass) const
+{
+    const int last = m_records.count() - 1;
+    int first = last;
+    while (first > 0) {
+        const Record &record = m_records[first - 1];
+        if (same_pass && (record.pass != m_records[last].pass || record.operation != m_records[last].operation)) {
+            break;
+        }
+        if (first < last && record.time < m_records[last].time - window) {
+            break;
+        }
+        --first;
+    }
+    return first;
+}
+
+qint64 RescueHistory::bytes(int record, quint8 status_mask) const
+{
+    qint64 sum = 0;
+    for (int status = 0; status < BlockStatus::code_count; ++status) {
+        if (status_mask & (1 << status)) {
+            sum += m_records[record].bytes[status];
+        }
+    }
+    return sum;
+}
+
+/*
+ * Change per second of the bytes of the statuses in status_mask (bit 1 << status code),
+ * e.g. positive for the recovered bytes. 0 until there are two records.
+ */
+qreal RescueHistory::rate(quint8 status_mask, qint64 window) const
+{
+    if (m_records.count() < 2) {
+        return 0;
+    }
+    const int last = m_records.count() - 1;
+    const int first = windowStart(window, false);
+    const qint64 elapsed = m_records[last].time - m_records[first].time;
+    return (bytes(last, status_mask) - bytes(first, status_mask)) * 1000.0 / elapsed;
+}
+
+/*
+ * Time for the current pass to get through the bytes it works on, e.g. the non-tried
+ * bytes while copying, at the speed measured since the pass started (within window).
+ */
+qint64 RescueHistory::passRemainingTime(qint64 window) const
+{
+    if (m_records.count() < 2) {
+        return -1;
+    }
+    const int last = m_records.count() - 1;
+    const BlockStatus::Code status = passStatus(m_records[last].operation);
+    const int first = windowStart(window, true);
+    if (status == BlockStatus::Unknown || first == last) {
+        return -1;
+    }
+    const qint64 done = m_records[first].bytes[status] - m_records[last].bytes[status];
+    if (done <= 0) {
+        return -1;
+    }
+    const qint64 elapsed = m_records[last].time - m_records[first].time;
+    return qint64(qreal(m_records[last].bytes[status]) * elapsed / done);
+}
@@ -0,0 +1,93 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESCUE_HISTORY_H
+#define RESCUE_HISTORY_H
+
+#include "block_status.h"
+
+#include <QString>
+#include <QVector>
+
+class RescueStatus;
+class RescueTotals;
+
+/**
+ * Bounded history of the totals of a mapfile across its refreshes, to tell how fast
+ * the rescue goes: recovered bytes per second, growth of the failed areas and the
+ * remaining time of the current pass.
+ *
+ * The history is kept in a small sidecar file so that it survives the viewer. The
+ * file holds a header then one record per snapshot, each field stored as a zigzag
+ * varint of its difference with the previous record: a refresh appends a few dozen
+ * bytes and never reads the older records back. The file is read once by open(), and
+ * rewritten with the newest capacity() records when it holds twice as many.
+ *
+ * Records must come in time order: a snapshot not newer than the last record (e.g.
+ * the same mapfile opened again) is not appended, and a snapshot of a domain of a
+ * different size (another rescue with the same mapfile name) starts a new history.
+ */
+class RescueHistory
+{
+public:
+    struct Record
+    {
+        qint64 time;      // milliseconds since the epoch
+        qint64 position;  // from the status line
+        qint64 pass;
+        qint64 operation; // character of the status line, 0 when unknown
+        qint64 bytes[BlockStatus::code_count];  // indexed by status code
+    };
+
+    static const int default_capacity = 1024;
+    static const qint64 default_window = 10 * 60 * 1000;  // rates are averaged over 10 minutes
+
+    explicit RescueHistory(int capacity = default_capacity);
+
+    bool open(const QString &file_name);
+    bool append(const Record &record);
+    void clear();
+    static Record capture(qint64 time, const RescueStatus &status, const RescueTotals &totals);
+    static QString cacheFileName(const QString &mapfile_name);
+
+    QString fileName() const { return m_file_name; }
+    QString errorString() const { return m_error; }
+    int capacity() const { return m_capacity; }
+    int count() const { return m_records.count(); }
+    const Record &at(int i) const { return m_records[i]; }
+
+    qreal rate(quint8 status_mask, qint64 window = default_window) const;  // bytes per second
+    qint64 passRemainingTime(qint64 window = default_window) const;  // milliseconds, -1 when unknown
+    static BlockStatus::Code passStatus(qint64 operation);  // the status the operation works on
+
+private:
+    int windowStart(qint64 window, bool same_pass) const;
+    qint64 bytes(int record, quint8 status_mask) const;
+    bool save();
+
+    QVector<Record> m_records;
+    int m_capacity;
+    QString m_file_name;
+    bool m_synced;  // the file holds exactly m_records, a record can be appended to it
+    QString m_error;
+};
+
+#endif // RESCUE_HISTORY_H
@@ -22,19 +22,29 @@
 #include "rescue_map.h"
 #include "block_position.h"
 #include "block_size.h"
-#include "block_status.h"
+#include "block_table.h"
 #include "rescue_totals.h"
-#include "square_color.h"
+#include "square_palette.h"
 
-#include <cmath>
-#include <QDebug>
+#include <QColor>
+#include <QRect>
 #include <QSize>
+#include <QThread>
+#include <QtConcurrentMap>
+
+#include <algorithm>
 
 RescueMap::RescueMap(QObject *parent)
     : QAbstractTableModel(parent)
     , m_columns(1)
     , m_rows(1)
-    , m_square_colors()
+    , m_window_start(0)
+    , m_square_bytes(0)
+    , m_computed_start(0)
+    , m_computed_bytes(0)
+    , m_square_masks(1, 0)
+    , m_square_pixels(1, SquarePalette::pixel(0))
+    , m_overview_pixels(overview_rows, SquarePalette::pixel(0))
 {
 }
 
@@ -45,7 +55,7 @@ QVariant RescueMap::data(const QModelIndex &index, int role) const
 
     if (role == Qt::BackgroundRole) {
         int square = m_columns * index.row() + index.column();
-        return m_square_colors.at(square);
+        return QColor::fromRgba(m_square_pixels.at(square));
     }
     
     if (role == Qt::SizeHintRole) {
@@ -62,172 +72,383 @@ QVariant RescueMap::headerData(int /* section */, Qt::Orientation /* orientation
     return QVariant();
 }
 
-void RescueMap::setMap(const QVector<BlockPosition> &positions, const QVector<BlockSize> &sizes, const QVector<BlockStatus> &statuses)
+/*
+ * A new map over the same domain, e.g. the mapfile refreshed by ddrescue, keeps the
+ * grid: the views are only told which squares changed color.
+ */
+void RescueMap::setMap(const BlockTable &blocks)
 {
-    beginResetModel();
-    m_positions = positions;
-    m_sizes = sizes;
-    m_statuses = statuses;
+    const bool same_domain = !m_blocks.isEmpty() && !blocks.isEmpty()
+        && blocks.domainStart() == m_blocks.domainStart()
+        && blocks.domainFinish() == m_blocks.domainFinish();
+    if (!same_domain) {
+        beginResetModel();
+        m_square_bytes = 0;  // the zoom window of another domain is meaningless
+    }
+    const QVector<QRgb> previous_pixels = m_square_pixels;  // shared until computeSquareColors() writes
+    m_blocks = blocks;
+    m_computed_bytes = 0;  // the statuses of every square may have changed
+    m_totals_index.build(m_blocks);
+    m_pyramid.build(m_blocks, m_totals_index);
     computeSquareColors();
-    endResetModel();
+    computeOverlay();
+    computeOverview();
+    if (!same_domain) {
+        endResetModel();
+    } else {
+        emitChangedSquares(previous_pixels);
+    }
+    emit overviewChanged();
 }
 
 /*
- * Extract a sub map, e.g. the map corresponding to a square on the grid view
- * Usage: showing the details of a square in block inspector
+ * The overlay is redrawn on every square, the squares keep their colors
  */
-RescueMap* RescueMap::extract(BlockPosition p, BlockSize s) const
+void RescueMap::setOverlay(const MapDiff &diff)
 {
-    RescueMap* map = new RescueMap();
-    QVector<BlockPosition> positions;
-    QVector<BlockSize> sizes;
-    QVector<BlockStatus> statuses;
-    
-    for(int line = 0; line < m_positions.count(); ++line) {
-        BlockPosition extract_start = p;
-        BlockSize extract_size = s;
-        BlockPosition extract_finish = extract_start + extract_size;
-        
-        BlockPosition block_start = m_positions[line];
-        BlockSize block_size = m_sizes[line];
-        BlockPosition block_finish = block_start + block_size;
-        
-        BlockStatus block_status = m_statuses[line];
-        
-        // case 1: block_start < block_finish < extract_start < extract_finish
-        // nothing to extract yet
-        if ( block_finish <= extract_start ) {
-            continue;  
-        }
-        
-        // case 2: block_start < extract_start < block_finish < extract_finish
-        // extract the beginning of the block
-        if ( block_start <= extract_start && extract_start < block_finish && block_finish <= extract_finish ) {
-            positions.append(BlockPosition(extract_start));
-            sizes.append(BlockSize(block_finish - extract_start));
-            statuses.append(BlockStatus(block_status));
-            continue;
-        }
-        
-        // case 3: block_start < extract_start < extract_finish < block_finish
-        // the extract is entirely contained in the block
-        if ( block_start <= extract_start && extract_start < extract_finish && extract_finish <= block_finish ) {
-            positions.append(BlockPosition(extract_start));
-            sizes.append(BlockSize(extract_size));
-            statuses.append(BlockStatus(block_status));
-            map->setMap(positions, sizes, statuses);
-            return map;
-        }
-        
-        // case 4: extract_start < block_start < block_finish < extract_finish )
-        // the block is entirely contained in the extract
-        if ( extract_start <= block_start && block_finish <= extract_finish ) {
-            positions.append(BlockPosition(block_start));
-            sizes.append(BlockSize(block_size));
-            statuses.append(BlockStatus(block_status));
-            continue;
-        }
-        
-        // case 5: extract_start < block_start < extract_finish < block_finish )
-        // extract the end of the block
-        if ( extract_start <= block_start && block_start < extract_finish && extract_finish <= block_finish ) {
-            positions.append(BlockPosition(block_start));
-            sizes.append(BlockSize(extract_finish - block_start));
-            statuses.append(BlockStatus(block_status));
-            map->setMap(positions, sizes, statuses);
-            return map;
-        }
+    if (diff.isEmpty() && m_overlay.isEmpty()) {
+        return;
+    }
+    m_overlay = diff;
+    computeOverlay();
+    emit dataChanged(index(0, 0), index(m_rows - 1, m_columns - 1), { Qt::BackgroundRole });
+}
+
+void RescueMap::computeOverlay()
+{
+    if (m_overlay.isEmpty()) {
+        m_overlay_masks.clear();
+        return;
+    }
+    const int squares = m_columns * m_rows;
+    m_overlay_masks.fill(0, squares);
+    for (int square = 0; square < squares; ++square) {
+        m_overlay_masks[square] = m_overlay.highlight(squareStart(square), squareStart(square + 1));
+    }
+}
+
+/*
+ * The overview does not depend on the window nor on the dimensions of the grid:
+ * scrolling or zooming never computes it again.
+ */
+void RescueMap::computeOverview()
+{
+    m_overview_pixels.fill(SquarePalette::pixel(0), overview_rows);
+    if (m_blocks.isEmpty()) {
+        return;
+    }
+    QVector<quint8> masks(overview_rows, 0);
+    const qint64 start = m_blocks.domainStart();
+    const qint64 size = m_blocks.domainFinish() - start;
+    for (int row = 0; row < overview_rows; ++row) {
+        const qint64 row_start = start + size * row / overview_rows;
+        const qint64 row_finish = start + size * (row + 1) / overview_rows;
+        /* rows smaller than a byte, on tiny maps, show the byte they fall on */
+        masks[row] = m_pyramid.mask(row_start, qMax(row_finish, row_start + 1));
+    }
+    SquarePalette::toPixels(masks.constData(), m_overview_pixels.data(), overview_rows);
+}
+
+/*
+ * Emit dataChanged() for the squares of another color than in previous_pixels, coalesced
+ * in rectangles: changed squares close on a row make a run, and a run overlapping the
+ * columns of a rectangle of the previous row extends it.
+ *
+ * The rectangles are not exact: they also span the unchanged squares between the
+ * changed ones, up to max_gap in a row and the corners of the bounding box of runs
+ * merged across rows. Those squares are repainted with the same color. That bounds
+ * the count of signals, each of which invalidates tiles of the view, when a refresh
+ * changes scattered squares.
+ */
+void RescueMap::emitChangedSquares(const QVector<QRgb> &previous_pixels)
+{
+    if (previous_pixels.count() != m_square_pixels.count()) {
+        return;
+    }
+    const int max_gap = 8;  // unchanged squares within a run
+    const QVector<int> roles { Qt::BackgroundRole };
+    QVector<QRect> open;  // rectangles reaching the previous row
+    QVector<QRect> extended;
 
-        // case 6: extract_start < extract_finish < block_start < block_finish )
-        // nothing to extract (any more)
-        if ( extract_finish <= block_start ) {
-            return map;
+    for (int row = 0; row <= m_rows; ++row) {
+        extended.clear();
+        if (row < m_rows) {
+            const QRgb *before = previous_pixels.constData() + row * m_columns;
+            const QRgb *after = m_square_pixels.constData() + row * m_columns;
+            for (int column = 0; column < m_columns; ) {
+                if (before[column] == after[column]) {
+                    ++column;
+                    continue;
+                }
+                /* a run of changed squares, up to max_gap unchanged squares apart */
+                const int first = column;
+                int last = column;
+                for (++column; column < m_columns && column <= last + max_gap + 1; ++column) {
+                    if (before[column] != after[column]) {
+                        last = column;
+                    }
+                }
+                QRect run(first, row, last - first + 1, 1);
+                for (int i = 0; i < open.count(); ) {
+                    const QRect &rect = open.at(i);
+                    if (rect.left() <= run.right() && run.left() <= rect.right()) {
+                        run = QRect(QPoint(qMin(rect.left(), run.left()), qMin(rect.top(), run.top())),
+                                    QPoint(qMax(rect.right(), run.right()), row));
+                        open.remove(i);
+                    } else {
+                        ++i;
+                    }
+                }
+                extended.append(run);
+            }
         }
-        
-        qDebug() << "Why are we here?" << endl;
-        qDebug() << "Extract block:" << extract_start << extract_size << endl;
-        qDebug() << "Block:" << block_start << block_size << endl;
+        for (const QRect &rect : open) {
+            emit dataChanged(index(rect.top(), rect.left()), index(rect.bottom(), rect.right()), roles);
+        }
+        open.swap(extended);
     }
-    map->setMap(positions, sizes, statuses);
+}
+
+BlockRange RescueMap::range(BlockPosition p, BlockSize s) const
+{
+    return BlockRange(m_blocks, p.data(), p.data() + s.data());
+}
+
+/*
+ * Extract a sub map, e.g. the map corresponding to a square on the grid view
+ * Usage: showing the details of a square in block inspector, when range() does not
+ * live long enough
+ */
+RescueMap* RescueMap::extract(BlockPosition p, BlockSize s) const
+{
+    RescueMap* map = new RescueMap();
+    map->setMap(range(p, s).toTable());
     return map;
 }
 
 BlockPosition RescueMap::start() const
 {
-    if (m_positions.count()) {
-        return m_positions.at(0);
+    if (m_blocks.count()) {
+        return BlockPosition(m_blocks.domainStart());
     }
     return BlockPosition();
 }
 
 BlockSize RescueMap::size() const
 {
-    if (m_positions.count() && m_sizes.count()) {
-        int last_row = m_positions.count() - 1;
-        return BlockSize( m_positions.at(last_row) + m_sizes.at(last_row) - start() );
+    if (m_blocks.count()) {
+        return BlockSize(m_blocks.domainFinish() - m_blocks.domainStart());
     }
     return BlockSize();
 }
 
+RescueTotals RescueMap::totals(BlockPosition start, BlockSize size) const
+{
+    return m_totals_index.totals(start.data(), start.data() + size.data());
+}
+
 void RescueMap::setDimensions(int columns, int rows)
 {
-    beginResetModel();
-    m_columns = (columns > 0) ? columns : 1;
-    m_rows = (rows > 0) ? rows : 1;
+    setGrid(columns, rows, m_window_start, m_square_bytes);
+}
+
+/*
+ * Zooming or panning only re-buckets the squares of the window
+ */
+void RescueMap::setWindow(qint64 window_start, qint64 square_bytes)
+{
+    setGrid(m_columns, m_rows, window_start, square_bytes);
+}
+
+/*
+ * Set the dimensions and the window at once, e.g. to reflow the squares of a fixed
+ * byte size into another number of columns. Only new dimensions reset the model.
+ */
+void RescueMap::setGrid(int columns, int rows, qint64 window_start, qint64 square_bytes)
+{
+    const qint64 sector_size = 512;
+    columns = (columns > 0) ? columns : 1;
+    rows = (rows > 0) ? rows : 1;
+    square_bytes = (square_bytes > 0) ? qMax(square_bytes, sector_size) : 0;
+    window_start = (square_bytes > 0) ? window_start : 0;
+    if (columns == m_columns && rows == m_rows
+            && window_start == m_window_start && square_bytes == m_square_bytes) {
+        return;
+    }
+    if (columns != m_columns || rows != m_rows) {
+        beginResetModel();
+        m_columns = columns;
+        m_rows = rows;
+        m_window_start = window_start;
+        m_square_bytes = square_bytes;
+        computeSquareColors();
+        computeOverlay();
+        endResetModel();
+        return;
+    }
+
+    /* the views still showing the previous window when the squares are signaled, e.g.
+     * RescueMapWidget, tell a move from a refresh by the window */
+    const QVector<QRgb> previous_pixels = m_square_pixels;
+    m_window_start = window_start;
+    m_square_bytes = square_bytes;
     computeSquareColors();
-    endResetModel();
+    computeOverlay();
+    emitChangedSquares(previous_pixels);
+    emit windowChanged();
+}
+
+qint64 RescueMap::windowStart() const
+{
+    return isFitted() ? start().data() : m_window_start;
+}
+
+/*
+ * The window starts on a whole row from the start of the domain, as RescueMapWidget
+ * moves it
+ */
+qint64 RescueMap::firstRow() const
+{
+    return (windowStart() - start().data()) / (squareBytes() * m_columns);
+}
+
+/*
+ * Whole sectors per square, in 64-bit: a 3 TB map on a single square is 5.8 billion sectors
+ */
+qint64 RescueMap::squareBytes() const
+{
+    if (!isFitted()) {
+        return m_square_bytes;
+    }
+    const qint64 sector_size = 512;
+    const qint64 squares = qint64(m_columns) * m_rows;
+    const qint64 sectors = (size().data() + sector_size - 1) / sector_size;
+    return sector_size * qMax((sectors + squares - 1) / squares, qint64(1));
+}
+
+/*
+ * A rectangle spanning the whole rows is a single range. The squares after the end
+ * of the map are left out.
+ */
+MapSelection RescueMap::selection(const QRect &squares) const
+{
+    MapSelection result;
+    const QRect grid = squares.intersected(QRect(0, 0, m_columns, m_rows));
+    const qint64 finish = m_blocks.domainFinish();
+    for (int row = grid.top(); row <= grid.bottom(); ++row) {
+        const int first = row * m_columns + grid.left();
+        const int last = row * m_columns + grid.right();
+        result.addRange(squareStart(first), qMin(squareStart(last + 1), finish));
+    }
+    return result;
 }
 
+namespace {
+
+/* a contiguous run of squares computed by one thread */
+struct SquareRun
+{
+    int first;
+    int count;
+};
+
+}
+
+/*
+ * Squares of the previous window with the same byte range, e.g. after a resize or a
+ * pan with a fixed square size, keep their mask and pixel: only the others are computed.
+ */
 void RescueMap::computeSquareColors()
 {
-    m_square_colors.clear();                  // capacity preserved from Qt 5.7
     const int squares = m_columns * m_rows;
-    m_square_colors.reserve(squares);
-    
-    const BlockSize sector_size = 512;
-    const BlockSize square_size = sector_size * ceil(size()/sector_size/squares);
-
-    if (!m_positions.count()) {
-        m_square_colors.fill(SquareColor(), squares);  // fill the grid with ligthgray
+    const QVector<quint8> previous_masks = m_square_masks;  // shared until filled below
+    const QVector<QRgb> previous_pixels = m_square_pixels;
+    const qint64 previous_start = m_computed_start;
+    const qint64 previous_bytes = m_computed_bytes;
+    m_square_masks.fill(0, squares);  // no status: the grid is ligthgray, capacity preserved from Qt 5.7
+    m_square_pixels.fill(SquarePalette::pixel(0), squares);
+    m_computed_bytes = 0;
+    if (m_blocks.isEmpty()) {
         return;
     }
     
-    /* iteration over all the squares and all the mapfile lines */
-    RescueTotals square_totals;
-    BlockPosition section_start = start();
-    BlockPosition square_end = start() + square_size;
-
-    for (int square = 0, line = 0; square < squares && line < m_positions.count(); ) {
-        BlockPosition line_end = m_positions.at(line) + m_sizes.at(line);
-        
-        if (square_end <= line_end) {
-            // case 1: square_end <= line_end
-            // color can be computed and saved for the square
-            square_totals.add(square_end - section_start, m_statuses.at(line));
-            m_square_colors.append(SquareColor(square_totals));
-            square_totals.reset();
-            ++square;
-            if (square_end == line_end) { ++line; }
-            section_start = square_end;
-            square_end = square_end + square_size;
-        } 
-        else {
-            // case 2: square_end > line_end
-            // the square totals still have lines to process before computing the color
-            square_totals.add(line_end - section_start, m_statuses.at(line));
-            ++line;
-            if (line == m_positions.count()) { m_square_colors.append(SquareColor(square_totals)); }
-            section_start = line_end;
+    const qint64 start = windowStart();
+    const qint64 finish = m_blocks.domainFinish();
+    const qint64 square_size = squareBytes();
+    if (finish <= start) {
+        return;
+    }
+    /* the squares after the end of the map, if any, are left lightgray */
+    const int covered = int(qMin(qint64(squares), (finish - start + square_size - 1) / square_size));
+    m_computed_start = start;
+    m_computed_bytes = square_size;
+
+    /* the squares first to last - 1 were computed for the previous window */
+    int first = 0;
+    int last = 0;
+    if (previous_bytes == square_size && (start - previous_start) % square_size == 0) {
+        const qint64 shift = (start - previous_start) / square_size;  // previous index of square 0
+        first = int(qBound(qint64(0), -shift, qint64(covered)));
+        last = int(qBound(qint64(first), previous_masks.count() - shift, qint64(covered)));
+        if (first < last) {
+            std::copy(previous_masks.constBegin() + (first + shift), previous_masks.constBegin() + (last + shift),
+                      m_square_masks.begin() + first);
+            std::copy(previous_pixels.constBegin() + (first + shift), previous_pixels.constBegin() + (last + shift),
+                      m_square_pixels.begin() + first);
+        } else {
+            first = last = 0;
         }
     }
+    computeSquares(0, first, start, square_size);
+    computeSquares(last, covered - last, start, square_size);
 }
 
-QDebug operator<<(QDebug dbg, const RescueMap &map)
+/*
+ * Compute count squares from first, the window starting at start
+ */
+void RescueMap::computeSquares(int first, int count, qint64 start, qint64 square_size)
 {
-    dbg << "RescueMap" << endl;
-    for(int row = 0; row < map.m_positions.count(); ++row)
-    {
-        dbg << map.m_positions[row] << " " << map.m_sizes[row] << " " << map.m_statuses[row] << endl;
+    if (count <= 0) {
+        return;
+    }
+
+    /* runs of at least min_run squares, at most one per core */
+    const int min_run = 4096;
+    const int run_count = qBound(1, count / min_run, QThread::idealThreadCount());
+    QVector<SquareRun> runs;
+    runs.reserve(run_count);
+    for (int run = 0; run < run_count; ++run) {
+        const int run_first = first + int(qint64(count) * run / run_count);
+        const int run_last = first + int(qint64(count) * (run + 1) / run_count);
+        runs.append(SquareRun{run_first, run_last - run_first});
+    }
+
+    /* the color of a square only depends on the statuses present, as summarized by the pyramid */
+    quint8 *masks = m_square_masks.data();  // detached once, before the threads write to them
+    QRgb *pixels = m_square_pixels.data();
+    const qint64 finish = m_blocks.domainFinish();
+    /* level of detail: power of two squares aligned on the pyramid are read from one of its levels */
+    const int level = m_pyramid.nodeLevel(start, square_size);
+    auto computeRun = [&](const SquareRun &run) {
+        if (level >= 0) {
+            const qint64 first_node = (start - m_pyramid.origin()) / square_size;
+            const qint64 node_count = m_pyramid.nodeCount(level);
+            for (int square = run.first; square < run.first + run.count; ++square) {
+                const qint64 node = first_node + square;
+                masks[square] = (node < node_count) ? m_pyramid.mask(level, int(node)) : 0;
+            }
+        } else {
+            for (int square = run.first; square < run.first + run.count; ++square) {
+                const qint64 square_start = start + square * square_size;
+                const qint64 square_end = qMin(square_start + square_size, finish);
+                masks[square] = m_pyramid.mask(square_start, square_end);
+            }
+        }
+        SquarePalette::toPixels(masks + run.first, pixels + run.first, run.count);
+    };
+    if (run_count > 1) {
+        QtConcurrent::blockingMap(runs, computeRun);
+    } else {
+        computeRun(runs.first());
     }
-    return dbg.maybeSpace();
 }
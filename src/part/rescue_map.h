@@ -23,10 +23,17 @@
 #define RESCUE_MAP_H
 
 #include <QAbstractTableModel>
+#include <QRect>
+#include <QRgb>
 #include "block_position.h"
+#include "block_range.h"
 #include "block_size.h"
-#include "block_status.h"
+#include "block_table.h"
+#include "coverage_pyramid.h"
+#include "map_diff.h"
+#include "map_selection.h"
 #include "square_color.h"
+#include "totals_index.h"
 
 class RescueTotals;
 
@@ -43,29 +50,78 @@ public:
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
-    void setMap(const QVector<BlockPosition> &positions, const QVector<BlockSize> &sizes, const QVector<BlockStatus> &statuses);
+    void setMap(const BlockTable &blocks);
+    const BlockTable &blocks() const { return m_blocks; }
+    BlockRange range(BlockPosition start, BlockSize size) const;
     RescueMap* extract(BlockPosition start, BlockSize size) const;
     BlockPosition start() const;
     BlockSize size() const;
+    RescueTotals totals() const { return m_totals_index.totals(); }
+    RescueTotals totals(BlockPosition start, BlockSize size) const;
+
+    // the grid, as one packed ARGB pixel per square, row by row, for the raster views
+    int columns() const { return m_columns; }
+    int rows() const { return m_rows; }
+    const QVector<QRgb> &squarePixels() const { return m_square_pixels; }
+
+    // the byte window shown on the grid: the whole domain fitted on the squares by default,
+    // or square_bytes per square from window_start, e.g. once zoomed in. Moving the window
+    // keeps the shape of the model: the squares of another color are signaled by
+    // dataChanged(), then windowChanged() is emitted.
+    void setWindow(qint64 window_start, qint64 square_bytes);
+    void fitWindow() { setWindow(0, 0); }
+    bool isFitted() const { return m_square_bytes == 0; }
+    void setGrid(int columns, int rows, qint64 window_start, qint64 square_bytes);
+    qint64 windowStart() const;
+    qint64 squareBytes() const;
+    qint64 squareStart(int square) const { return windowStart() + square * squareBytes(); }
+    qint64 firstRow() const;  // row of the domain on the first row of the grid
+
+    // the bytes of a rectangle of squares (columns and rows of the grid), row by row
+    MapSelection selection(const QRect &squares) const;
+
+    // changes since a snapshot of the map, and their MapDiff::Highlight bits on each square
+    MapDiff diff(const BlockTable &snapshot) const { return MapDiff::compare(snapshot, m_blocks); }
+    void setOverlay(const MapDiff &diff);
+    void clearOverlay() { setOverlay(MapDiff()); }
+    bool hasOverlay() const { return !m_overlay.isEmpty(); }
+    const QVector<quint8> &overlayMasks() const { return m_overlay_masks; }
+
+    // the whole domain in overview_rows pixels, computed once per map for the minimap
+    const QVector<QRgb> &overviewPixels() const { return m_overview_pixels; }
+    static const int overview_rows = 1024;
 
     friend class RescueTotals;
-    friend QDebug operator<<(QDebug dbg, const RescueMap &map);
 
 public slots:
     void setDimensions(int columns, int rows);
+
+signals:
+    void overviewChanged();
+    void windowChanged();
     
 private:
-    QVector<BlockPosition> m_positions;
-    QVector<BlockSize> m_sizes;
-    QVector<BlockStatus> m_statuses;
+    BlockTable m_blocks;
+    TotalsIndex m_totals_index;  // built once per map, to compute the totals of any range
+    CoveragePyramid m_pyramid;  // built once per map, to compute the colors of any square
     
     int m_columns;
     int m_rows;
-    QVector<SquareColor> m_square_colors;
+    qint64 m_window_start;
+    qint64 m_square_bytes;  // 0 to fit the domain
+    qint64 m_computed_start;  // window of m_square_masks, reused when the squares are the same
+    qint64 m_computed_bytes;  // 0 when they are not valid any more
+    QVector<quint8> m_square_masks;  // statuses present in each square
+    QVector<QRgb> m_square_pixels;  // color of each square, from SquarePalette
+    QVector<QRgb> m_overview_pixels;
+    MapDiff m_overlay;
+    QVector<quint8> m_overlay_masks;  // empty without overlay
     void computeSquareColors();
+    void computeSquares(int first, int count, qint64 start, qint64 square_size);
+    void computeOverview();
+    void computeOverlay();
+    void emitChangedSquares(const QVector<QRgb> &previous_pixels);
     
 };
 
-QDebug operator<<(QDebug dbg, const RescueMap &map);  // prettify debug output
-
 #endif // RESCUE_MAP_H
@@ -0,0 +1,120 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rescue_map_painter.h"
+#include "rescue_map.h"
+
+#include <QImage>
+#include <QLine>
+#include <QPainter>
+#include <QPen>
+#include <QVector>
+
+RescueMapPainter::RescueMapPainter()
+    : m_map(nullptr)
+    , m_square_size(8)
+    , m_grid_color()
+{
+}
+
+QSize RescueMapPainter::size() const
+{
+    if (!m_map) {
+        return QSize();
+    }
+    return QSize(m_map->columns() * m_square_size, m_map->rows() * m_square_size);
+}
+
+/*
+ * Returns false when nothing was painted: no map, no square pixels yet, or no square in the clip
+ */
+bool RescueMapPainter::paint(QPainter *painter, const QRect &clip) const
+{
+    if (!m_map || m_square_size <= 0) {
+        return false;
+    }
+    const int columns = m_map->columns();
+    const int rows = m_map->rows();
+    const QVector<QRgb> &pixels = m_map->squarePixels();
+    if (pixels.count() < columns * rows) {
+        return false;
+    }
+
+    /* only the squares intersecting the clip rectangle */
+    const QRect squares = QRect(clip.left() / m_square_size, clip.top() / m_square_size,
+                                clip.width() / m_square_size + 2, clip.height() / m_square_size + 2)
+                          .intersected(QRect(0, 0, columns, rows));
+    if (squares.isEmpty()) {
+        return false;
+    }
+    const QRect target(squares.left() * m_square_size, squares.top() * m_square_size,
+                       squares.width() * m_square_size, squares.height() * m_square_size);
+
+    /* the pixel buffer is blitted as is: a QRgb per square is an ARGB32 image */
+    const QImage image(reinterpret_cast<const uchar*>(pixels.constData()), columns, rows,
+                       columns * int(sizeof(QRgb)), QImage::Format_ARGB32);
+    painter->save();
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
+    painter->drawImage(target, image, squares);
+
+    if (m_grid_color.isValid() && m_square_size > 1) {
+        QVector<QLine> lines;
+        lines.reserve(squares.width() + squares.height());
+        for (int column = squares.left(); column <= squares.right(); ++column) {
+            const int x = column * m_square_size + m_square_size - 1;
+            lines.append(QLine(x, target.top(), x, target.bottom()));
+        }
+        for (int row = squares.top(); row <= squares.bottom(); ++row) {
+            const int y = row * m_square_size + m_square_size - 1;
+            lines.append(QLine(target.left(), y, target.right(), y));
+        }
+        painter->setPen(QPen(m_grid_color, 0));
+        painter->drawLines(lines);
+    }
+
+    /* changes since a snapshot: a frame inside the square, in colors out of the palette */
+    const QVector<quint8> &overlay = m_map->overlayMasks();
+    if (overlay.count() == columns * rows && m_square_size > 2) {
+        QVector<QRect> recovered;
+        QVector<QRect> failed;
+        for (int row = squares.top(); row <= squares.bottom(); ++row) {
+            for (int column = squares.left(); column <= squares.right(); ++column) {
+                const quint8 highlight = overlay.at(row * columns + column);
+                if (!highlight) {
+                    continue;
+                }
+                const QRect frame(column * m_square_size, row * m_square_size, m_square_size - 2, m_square_size - 2);
+                if (highlight & MapDiff::NewlyFailed) {
+                    failed.append(frame);  // the bad news wins
+                } else {
+                    recovered.append(frame);
+                }
+            }
+        }
+        painter->setBrush(Qt::NoBrush);
+        painter->setPen(QPen(QColor(0, 255, 255), 0));
+        painter->drawRects(recovered);
+        painter->setPen(QPen(QColor(255, 0, 255), 0));
+        painter->drawRects(failed);
+    }
+    painter->restore();
+    return true;
+}
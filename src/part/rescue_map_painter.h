@@ -0,0 +1,60 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESCUE_MAP_PAINTER_H
+#define RESCUE_MAP_PAINTER_H
+
+#include <QColor>
+#include <QRect>
+#include <QSize>
+
+class QPainter;
+class RescueMap;
+
+/**
+ * Paint the grid of a RescueMap: its square pixels scaled to the square size in a
+ * single image blit, then the grid lines in a single pass. Each square is
+ * square_size pixels wide, its last column and row being the grid line, as in the
+ * QTableView of RescueMapView.
+ *
+ * When the map has an overlay, the squares with changes since the snapshot get a
+ * cyan frame when newly recovered, or a magenta frame when newly failed.
+ */
+class RescueMapPainter
+{
+public:
+    RescueMapPainter();
+
+    void setMap(const RescueMap *map) { m_map = map; }
+    void setSquareSize(int size) { m_square_size = size; }
+    void setGridColor(const QColor &color) { m_grid_color = color; }  // invalid color: no grid lines
+    int squareSize() const { return m_square_size; }
+
+    QSize size() const;  // of the whole grid, in pixels
+    bool paint(QPainter *painter, const QRect &clip) const;  // false: nothing painted
+
+private:
+    const RescueMap *m_map;
+    int m_square_size;
+    QColor m_grid_color;
+};
+
+#endif // RESCUE_MAP_PAINTER_H
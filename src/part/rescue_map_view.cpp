@@ -27,6 +27,8 @@
 
 RescueMapView::RescueMapView(QWidget *parent)
     :QTableView(parent)
+    ,m_columns(0)
+    ,m_rows(0)
     ,m_square_size(8)
 {
     setShowGrid(true);
@@ -59,11 +61,28 @@ void RescueMapView::resizeEvent(QResizeEvent *event)
     QTableView::resizeEvent(event);
 }
 
+/*
+ * The map may have been sized by another view meanwhile
+ */
+void RescueMapView::showEvent(QShowEvent *event)
+{
+    QTableView::showEvent(event);
+    m_columns = std::max( (width() - verticalScrollBar()->width()) / m_square_size, 1);
+    m_rows = std::max( height()/ m_square_size, 1);
+    RescueMap * rescue_map = dynamic_cast<RescueMap*> (model());
+    if (rescue_map) {
+        rescue_map->setDimensions(m_columns, m_rows);
+    }
+}
+
 void RescueMapView::setSquareSize(int size)
 {
     m_square_size = size;
     verticalHeader()->setDefaultSectionSize(m_square_size);
     horizontalHeader()->setDefaultSectionSize(m_square_size);
+    if (!isVisible()) {
+        return;  // the map is sized by the visible view
+    }
     
     int columns = std::max(width() / m_square_size - 1, 2);
     int rows = std::max(height() / m_square_size - 1, 2);
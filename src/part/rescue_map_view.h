@@ -39,6 +39,7 @@ public slots:
     
 protected:
     void resizeEvent(QResizeEvent *event) override;
+    void showEvent(QShowEvent *event) override;
     
 private:
     int m_columns;
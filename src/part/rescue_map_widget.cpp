@@ -0,0 +1,469 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rescue_map_widget.h"
+#include "rescue_map.h"
+
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QScrollBar>
+#include <QStyle>
+#include <QStyleOption>
+#include <QWheelEvent>
+
+#include <limits>
+
+
+RescueMapWidget::RescueMapWidget(QWidget *parent)
+    : QAbstractScrollArea(parent)
+    , m_map(nullptr)
+    , m_square_size(8)
+    , m_first_row(0)
+    , m_tile_bytes(0)
+    , m_square_bytes(0)
+    , m_keep_square_bytes(true)
+    , m_drag_y(0)
+    , m_drag_row(0)
+    , m_selecting(false)
+{
+    setFrameShape(QFrame::NoFrame);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);  // only shown when the domain does not fit
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    viewport()->setAttribute(Qt::WA_OpaquePaintEvent);  // the whole viewport is painted
+
+    /* the same grid line color as the item view */
+    QStyleOption option;
+    option.initFrom(this);
+    m_painter.setGridColor(QColor::fromRgba(QRgb(style()->styleHint(QStyle::SH_Table_GridLineColor, &option, this))));
+    m_painter.setSquareSize(m_square_size);
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, &RescueMapWidget::applyWindow);
+
+    m_dimensions_timer.setSingleShot(true);
+    m_dimensions_timer.setInterval(16);  // a frame at 60 Hz
+    connect(&m_dimensions_timer, &QTimer::timeout, this, &RescueMapWidget::updateDimensions);
+}
+
+void RescueMapWidget::setMap(RescueMap *map)
+{
+    if (m_map) {
+        disconnect(m_map, nullptr, this, nullptr);
+    }
+    m_map = map;
+    m_painter.setMap(map);
+    m_tiles.clear();
+    m_square_bytes = 0;
+    m_selection.clear();
+    updateScrollBar(0);
+    if (m_map) {
+        connect(m_map, &QAbstractItemModel::modelReset, this, &RescueMapWidget::mapReset);
+        connect(m_map, &QAbstractItemModel::dataChanged, this, &RescueMapWidget::squaresChanged);
+        connect(m_map, &RescueMap::overviewChanged, this, &RescueMapWidget::mapChanged);
+        connect(m_map, &RescueMap::windowChanged, this, &RescueMapWidget::windowChanged);
+        keepWindow();
+        updateDimensions();
+    }
+    viewport()->update();
+}
+
+void RescueMapWidget::setSquareSize(int size)
+{
+    m_square_size = size;
+    m_painter.setSquareSize(size);
+    updateDimensions();
+    viewport()->update();
+}
+
+/*
+ * The grid layout or the domain changed: all the tiles are rendered again
+ */
+void RescueMapWidget::mapReset()
+{
+    m_tiles.clear();
+    keepWindow();
+    if (m_map && m_map->isFitted() && m_square_bytes > 0) {
+        /* a map of another domain */
+        m_square_bytes = 0;
+        updateScrollBar(0);
+    }
+    viewport()->update();
+}
+
+/*
+ * A refresh may have changed the squares out of the window, which are not signaled
+ */
+void RescueMapWidget::mapChanged()
+{
+    m_tiles.keepRows(m_first_row, m_first_row + m_map->rows() - 1);
+}
+
+/*
+ * The tiles of the rows still in the window are reused, unless the bytes per square
+ * changed
+ */
+void RescueMapWidget::windowChanged()
+{
+    if (m_map->squareBytes() != m_tile_bytes) {
+        m_tiles.clear();
+    }
+    keepWindow();
+    viewport()->update();
+}
+
+void RescueMapWidget::keepWindow()
+{
+    m_first_row = m_map ? m_map->firstRow() : 0;
+    m_tile_bytes = m_map ? m_map->squareBytes() : 0;
+}
+
+/*
+ * Only the tiles with squares of another color are rendered and painted again. While
+ * the window moves, the squares signaled are the squares shifted on the grid, before
+ * windowChanged(): the tiles keep their rows of the domain.
+ */
+void RescueMapWidget::squaresChanged(const QModelIndex &top_left, const QModelIndex &bottom_right)
+{
+    if (m_map->firstRow() != m_first_row || m_map->squareBytes() != m_tile_bytes) {
+        return;
+    }
+    m_tiles.keepRows(m_first_row, m_first_row + m_map->rows() - 1);
+
+    const int tile_squares = TileCache::tile_squares;
+    QVector<QPoint> changed;
+    const int first_tile_row = int((m_first_row + top_left.row()) / tile_squares);
+    const int last_tile_row = int((m_first_row + bottom_right.row()) / tile_squares);
+    for (int tile_row = first_tile_row; tile_row <= last_tile_row; ++tile_row) {
+        for (int tile_column = top_left.column() / tile_squares; tile_column <= bottom_right.column() / tile_squares; ++tile_column) {
+            changed.append(QPoint(tile_column, tile_row));
+        }
+    }
+    m_tiles.remove(changed);
+    for (const QPoint &tile : changed) {
+        viewport()->update(TileCache::tileRect(tile, m_square_size, m_first_row));
+    }
+}
+
+void RescueMapWidget::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(viewport());
+    painter.fillRect(event->rect(), palette().color(QPalette::Window));
+    if (!m_map) {
+        return;
+    }
+
+    /* blit the cached tiles intersecting the exposed rectangle */
+    const QRect exposed = event->rect().intersected(QRect(QPoint(0, 0), m_painter.size()));
+    if (exposed.isEmpty()) {
+        return;
+    }
+    /* the tiles straddling the edges of the window hold rows out of it */
+    painter.setClipRect(exposed);
+    const QRect tiles = TileCache::tiles(exposed, m_square_size, m_first_row);
+    for (int tile_row = tiles.top(); tile_row <= tiles.bottom(); ++tile_row) {
+        for (int tile_column = tiles.left(); tile_column <= tiles.right(); ++tile_column) {
+            const QPoint tile(tile_column, tile_row);
+            painter.drawPixmap(TileCache::tileRect(tile, m_square_size, m_first_row).topLeft(),
+                               m_tiles.tile(m_painter, tile, m_first_row));
+        }
+    }
+    paintSelection(&painter);
+}
+
+/*
+ * The selected squares of the window are tinted with the highlight color, one
+ * rectangle per row of each selected range
+ */
+void RescueMapWidget::paintSelection(QPainter *painter)
+{
+    if (m_selection.isEmpty() || m_map->blocks().isEmpty()) {
+        return;
+    }
+    QColor color = palette().color(QPalette::Highlight);
+    color.setAlpha(96);
+    const int columns = m_map->columns();
+    const qint64 squares = qint64(columns) * m_map->rows();
+    const qint64 window_start = m_map->windowStart();
+    const qint64 square_bytes = m_map->squareBytes();
+    for (const MapSelection::Range &range : m_selection.ranges()) {
+        const qint64 first = qMax(range.start - window_start, qint64(0)) / square_bytes;
+        const qint64 last = qMin((range.finish - window_start + square_bytes - 1) / square_bytes, squares) - 1;
+        for (qint64 square = first; square <= last; ) {
+            const int row = int(square / columns);
+            const int column = int(square % columns);
+            const int count = int(qMin(last - square + 1, qint64(columns - column)));
+            painter->fillRect(column * m_square_size, row * m_square_size, count * m_square_size, m_square_size, color);
+            square += count;
+        }
+    }
+}
+
+/*
+ * Dragging a window edge sends a resize event per mouse move: the grid is laid out
+ * again at most once per frame.
+ */
+void RescueMapWidget::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    if (!m_dimensions_timer.isActive()) {
+        m_dimensions_timer.start();
+    }
+}
+
+/*
+ * The map may have been sized by another view meanwhile
+ */
+void RescueMapWidget::showEvent(QShowEvent *event)
+{
+    QAbstractScrollArea::showEvent(event);
+    updateDimensions();
+}
+
+void RescueMapWidget::updateDimensions()
+{
+    if (!m_map || !isVisible()) {
+        return;
+    }
+    const int columns = qMax(viewport()->width() / m_square_size, 1);
+    const int rows = qMax(viewport()->height() / m_square_size, 1);
+    if (columns == m_map->columns() && rows == m_map->rows()) {
+        return;
+    }
+    if (m_square_bytes == 0 && m_keep_square_bytes && !m_map->blocks().isEmpty()) {
+        m_square_bytes = m_map->squareBytes();  // from now on, the squares are only reflowed
+    }
+    if (m_square_bytes == 0) {
+        m_map->setDimensions(columns, rows);
+        return;
+    }
+
+    /* the rows are reflowed from the first byte shown, the map reuses the squares computed */
+    const qint64 first_byte = m_map->windowStart();
+    const qint64 row_bytes = m_square_bytes * columns;
+    const qint64 row = (first_byte - m_map->start().data()) / row_bytes;
+    m_map->setGrid(columns, rows, m_map->start().data() + row * row_bytes, m_square_bytes);
+    updateScrollBar(first_byte);
+    applyWindow();  // in case the scroll bar clamped the first row
+}
+
+/*
+ * Fit the whole domain on the grid again, which computes all the squares
+ */
+void RescueMapWidget::fitToWindow()
+{
+    m_square_bytes = 0;
+    updateScrollBar(0);  // hides the scroll bar before the viewport is measured
+    if (!m_map || !isVisible()) {
+        return;
+    }
+    const int columns = qMax(viewport()->width() / m_square_size, 1);
+    const int rows = qMax(viewport()->height() / m_square_size, 1);
+    m_map->setGrid(columns, rows, 0, 0);
+}
+
+void RescueMapWidget::setKeepSquareBytes(bool keep)
+{
+    m_keep_square_bytes = keep;
+}
+
+qint64 RescueMapWidget::rowBytes() const
+{
+    return m_square_bytes * m_map->columns();
+}
+
+/*
+ * Zoom by powers of two, keeping the byte under the anchor square under it. Zooming
+ * out until the whole domain fits the grid goes back to the fitted view.
+ */
+void RescueMapWidget::zoom(int steps, const QPoint &anchor)
+{
+    if (!m_map || m_map->blocks().isEmpty() || steps == 0) {
+        return;
+    }
+    const qint64 sector_size = 512;
+    const int columns = m_map->columns();
+    const int rows = m_map->rows();
+    const int column = qBound(0, anchor.x() / m_square_size, columns - 1);
+    const int row = qBound(0, anchor.y() / m_square_size, rows - 1);
+    const qint64 square_bytes = m_map->squareBytes();
+    const qint64 anchor_byte = m_map->windowStart() + (qint64(row) * columns + column) * square_bytes;
+
+    /* powers of two of sectors, the next one below or above the current square size */
+    qint64 bytes = square_bytes;
+    for (; steps > 0; --steps) {
+        qint64 power = sector_size;
+        while ((power << 1) < bytes) {
+            power <<= 1;
+        }
+        bytes = power;
+    }
+    for (; steps < 0; ++steps) {
+        qint64 power = sector_size;
+        while (power <= bytes) {
+            power <<= 1;
+        }
+        bytes = power;
+    }
+    const qint64 squares = qint64(columns) * rows;
+    const qint64 fit_bytes = (m_map->size().data() + squares - 1) / squares;
+    if (bytes >= fit_bytes) {
+        fitToWindow();
+        return;
+    }
+
+    m_square_bytes = bytes;
+    const qint64 row_bytes = rowBytes();
+    const qint64 anchor_row = (anchor_byte - m_map->start().data()) / row_bytes;
+    updateScrollBar(m_map->start().data() + qMax(anchor_row - row, qint64(0)) * row_bytes);
+    applyWindow();
+}
+
+/*
+ * One step of the scroll bar is one row of squares, from the start of the domain
+ */
+void RescueMapWidget::updateScrollBar(qint64 first_byte)
+{
+    QScrollBar *scroll_bar = verticalScrollBar();
+    const QSignalBlocker blocker(scroll_bar);
+    if (!m_map || m_square_bytes == 0) {
+        scroll_bar->setRange(0, 0);
+        return;
+    }
+    const qint64 row_bytes = rowBytes();
+    const qint64 total_rows = (m_map->size().data() + row_bytes - 1) / row_bytes;
+    const qint64 max_row = qMax(total_rows - m_map->rows(), qint64(0));
+    scroll_bar->setRange(0, int(qMin(max_row, qint64(std::numeric_limits<int>::max()))));
+    scroll_bar->setPageStep(m_map->rows());
+    scroll_bar->setSingleStep(1);
+    scroll_bar->setValue(int(qMin((first_byte - m_map->start().data()) / row_bytes, qint64(scroll_bar->maximum()))));
+}
+
+/*
+ * Center the rows of the zoomed window on a byte, e.g. clicked on the minimap
+ */
+void RescueMapWidget::showPosition(qint64 position)
+{
+    if (!m_map || m_square_bytes == 0) {
+        return;
+    }
+    const qint64 row = (position - m_map->start().data()) / rowBytes() - m_map->rows() / 2;
+    verticalScrollBar()->setValue(int(qBound(qint64(0), row, qint64(verticalScrollBar()->maximum()))));
+}
+
+void RescueMapWidget::applyWindow()
+{
+    if (!m_map || m_square_bytes == 0) {
+        return;
+    }
+    const qint64 row = verticalScrollBar()->value();
+    m_map->setWindow(m_map->start().data() + row * rowBytes(), m_square_bytes);
+}
+
+void RescueMapWidget::wheelEvent(QWheelEvent *event)
+{
+    if (event->modifiers() & Qt::ControlModifier) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        zoom(event->angleDelta().y() / 120, event->position().toPoint());
+#else
+        zoom(event->angleDelta().y() / 120, event->pos());
+#endif
+        event->accept();
+        return;
+    }
+    QAbstractScrollArea::wheelEvent(event);
+}
+
+QPoint RescueMapWidget::squareAt(const QPoint &pos) const
+{
+    return QPoint(qBound(0, pos.x() / m_square_size, m_map->columns() - 1),
+                  qBound(0, pos.y() / m_square_size, m_map->rows() - 1));
+}
+
+void RescueMapWidget::selectSquares(const QPoint &pos)
+{
+    m_selection = m_map->selection(QRect(m_selection_origin, squareAt(pos)).normalized());
+    viewport()->update();
+}
+
+void RescueMapWidget::clearSelection()
+{
+    if (m_selection.isEmpty()) {
+        return;
+    }
+    m_selection.clear();
+    viewport()->update();
+    emit selectionChanged();
+}
+
+void RescueMapWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton && m_map
+        && ((event->modifiers() & Qt::ShiftModifier) || m_square_bytes == 0)) {
+        m_selecting = true;
+        m_selection_origin = squareAt(event->pos());
+        selectSquares(event->pos());
+        event->accept();
+        return;
+    }
+    if (event->button() == Qt::LeftButton && m_square_bytes > 0) {
+        m_drag_y = event->pos().y();
+        m_drag_row = verticalScrollBar()->value();
+        viewport()->setCursor(Qt::ClosedHandCursor);
+        event->accept();
+        return;
+    }
+    QAbstractScrollArea::mousePressEvent(event);
+}
+
+void RescueMapWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    if (m_selecting) {
+        selectSquares(event->pos());
+        event->accept();
+        return;
+    }
+    if ((event->buttons() & Qt::LeftButton) && m_square_bytes > 0) {
+        verticalScrollBar()->setValue(m_drag_row - (event->pos().y() - m_drag_y) / m_square_size);
+        event->accept();
+        return;
+    }
+    QAbstractScrollArea::mouseMoveEvent(event);
+}
+
+void RescueMapWidget::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (m_selecting) {
+        m_selecting = false;
+        emit selectionChanged();
+    }
+    viewport()->unsetCursor();
+    QAbstractScrollArea::mouseReleaseEvent(event);
+}
+
+void RescueMapWidget::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_Escape && !m_selection.isEmpty()) {
+        clearSelection();
+        event->accept();
+        return;
+    }
+    QAbstractScrollArea::keyPressEvent(event);
+}
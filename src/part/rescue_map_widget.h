@@ -0,0 +1,113 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESCUE_MAP_WIDGET_H
+#define RESCUE_MAP_WIDGET_H
+
+#include "map_selection.h"
+#include "rescue_map_painter.h"
+#include "tile_cache.h"
+
+#include <QAbstractScrollArea>
+#include <QTimer>
+
+class RescueMap;
+
+/**
+ * Raster view of a RescueMap. Unlike RescueMapView, which queries the model cell by
+ * cell through an item delegate, it blits the packed square pixels of the map in
+ * one go with RescueMapPainter, through a cache of rendered tiles.
+ *
+ * Ctrl + mouse wheel zooms around the cursor, by powers of two down to one sector per
+ * square, as in the Python prototype. Once zoomed in, the wheel, the scroll bar or a
+ * drag with the left button pan the byte window row by row.
+ *
+ * Shift + drag, or a drag on the fitted view, selects a rectangle of squares, kept as
+ * byte ranges so that it follows zooming and panning. Escape clears the selection.
+ *
+ * By default, resizing the widget keeps the bytes per square: the squares are only
+ * reflowed into the new number of columns, and the domain is fitted again on request.
+ * Resizes are applied at most once per frame.
+ */
+class RescueMapWidget : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    RescueMapWidget(QWidget *parent = nullptr);
+
+    void setMap(RescueMap *map);
+    const MapSelection &selection() const { return m_selection; }
+
+public slots:
+    void setSquareSize(int size);
+    void showPosition(qint64 position);
+    void fitToWindow();
+    void setKeepSquareBytes(bool keep);
+    void clearSelection();
+
+signals:
+    void selectionChanged();
+
+private slots:
+    void mapReset();
+    void mapChanged();
+    void windowChanged();
+    void squaresChanged(const QModelIndex &top_left, const QModelIndex &bottom_right);
+    void applyWindow();
+    void updateDimensions();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+
+private:
+    void zoom(int steps, const QPoint &anchor);
+    QPoint squareAt(const QPoint &pos) const;
+    void selectSquares(const QPoint &pos);
+    void paintSelection(QPainter *painter);
+    void updateScrollBar(qint64 first_byte);
+    void keepWindow();
+    qint64 rowBytes() const;
+
+    RescueMap *m_map;
+    RescueMapPainter m_painter;
+    int m_square_size;
+    TileCache m_tiles;
+    qint64 m_first_row;  // window of the tiles: row of the domain on the first row of the grid
+    qint64 m_tile_bytes;  // and bytes per square
+    qint64 m_square_bytes;  // bytes per square, or 0 to fit the domain
+    bool m_keep_square_bytes;
+    QTimer m_dimensions_timer;  // throttles the resizes
+    int m_drag_y;
+    int m_drag_row;
+    MapSelection m_selection;
+    bool m_selecting;
+    QPoint m_selection_origin;  // square where the rubber band started
+};
+
+#endif // RESCUE_MAP_WIDGET_H
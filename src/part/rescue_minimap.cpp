@@ -0,0 +1,132 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rescue_minimap.h"
+#include "rescue_map.h"
+
+#include <QImage>
+#include <QMouseEvent>
+#include <QPainter>
+
+
+RescueMinimap::RescueMinimap(QWidget *parent)
+    : QWidget(parent)
+    , m_map(nullptr)
+{
+    setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Expanding);
+    setCursor(Qt::PointingHandCursor);
+}
+
+void RescueMinimap::setMap(RescueMap *map)
+{
+    if (m_map) {
+        disconnect(m_map, nullptr, this, nullptr);
+    }
+    m_map = map;
+    if (m_map) {
+        connect(m_map, &RescueMap::overviewChanged, this, &RescueMinimap::overviewChanged);
+        /* the window moves on each zoom or pan, and with the dimensions of the grid */
+        connect(m_map, &RescueMap::windowChanged, this, QOverload<>::of(&QWidget::update));
+        connect(m_map, &QAbstractItemModel::modelReset, this, QOverload<>::of(&QWidget::update));
+    }
+    overviewChanged();
+}
+
+QSize RescueMinimap::sizeHint() const
+{
+    return QSize(16, 256);
+}
+
+/*
+ * Scale the overview pixels of the map to the strip, once
+ */
+void RescueMinimap::overviewChanged()
+{
+    m_thumbnail = QPixmap();
+    if (m_map && !m_map->blocks().isEmpty() && !size().isEmpty()) {
+        const QVector<QRgb> &pixels = m_map->overviewPixels();
+        const QImage column(reinterpret_cast<const uchar*>(pixels.constData()),
+                            1, pixels.count(), int(sizeof(QRgb)), QImage::Format_ARGB32);
+        m_thumbnail = QPixmap::fromImage(column.scaled(width(), height(), Qt::IgnoreAspectRatio, Qt::FastTransformation));
+    }
+    update();
+}
+
+void RescueMinimap::paintEvent(QPaintEvent * /* event */)
+{
+    QPainter painter(this);
+    if (m_thumbnail.isNull()) {
+        painter.fillRect(rect(), palette().color(QPalette::Window));
+        return;
+    }
+    painter.drawPixmap(0, 0, m_thumbnail);
+
+    /* the bytes on the grid, at least a pixel high */
+    const qint64 window_start = m_map->windowStart();
+    const qint64 window_bytes = m_map->squareBytes() * m_map->columns() * m_map->rows();
+    const int top = toY(window_start);
+    const int bottom = qMax(toY(window_start + window_bytes), top + 1);
+    const QColor highlight = palette().color(QPalette::Highlight);
+    QColor fill = highlight;
+    fill.setAlpha(64);
+    painter.fillRect(QRect(0, top, width(), bottom - top), fill);
+    painter.setPen(highlight);
+    painter.drawRect(QRect(0, top, width() - 1, bottom - top - 1));
+}
+
+void RescueMinimap::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    overviewChanged();
+}
+
+void RescueMinimap::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        requestPosition(event->pos().y());
+    }
+}
+
+void RescueMinimap::mouseMoveEvent(QMouseEvent *event)
+{
+    if (event->buttons() & Qt::LeftButton) {
+        requestPosition(event->pos().y());
+    }
+}
+
+void RescueMinimap::requestPosition(int y)
+{
+    if (!m_map || m_map->blocks().isEmpty() || height() <= 0) {
+        return;
+    }
+    y = qBound(0, y, height() - 1);
+    emit positionRequested(m_map->start().data() + m_map->size().data() * y / height());
+}
+
+int RescueMinimap::toY(qint64 position) const
+{
+    const qint64 size = m_map->size().data();
+    if (size <= 0) {
+        return 0;
+    }
+    position = qBound(qint64(0), position - m_map->start().data(), size);
+    return int(double(position) / size * height());
+}
@@ -0,0 +1,68 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESCUE_MINIMAP_H
+#define RESCUE_MINIMAP_H
+
+#include <QPixmap>
+#include <QWidget>
+
+class RescueMap;
+
+/**
+ * Colored overview strip of the whole domain, beside the grid, as the mini-map scroll
+ * bar of ddrescueview and Kate. The overview pixels of the map are only scaled to the
+ * strip when the map is loaded or refreshed and when the strip is resized; navigating
+ * just moves the highlighted window over the cached pixmap.
+ *
+ * Clicking or dragging on the strip requests the position under the mouse.
+ */
+class RescueMinimap : public QWidget
+{
+    Q_OBJECT
+
+public:
+    RescueMinimap(QWidget *parent = nullptr);
+
+    void setMap(RescueMap *map);
+    QSize sizeHint() const override;
+
+signals:
+    void positionRequested(qint64 position);
+
+private slots:
+    void overviewChanged();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+private:
+    void requestPosition(int y);
+    int toY(qint64 position) const;
+
+    RescueMap *m_map;
+    QPixmap m_thumbnail;
+};
+
+#endif // RESCUE_MINIMAP_H
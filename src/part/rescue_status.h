@@ -24,6 +24,8 @@
 
 #include "block_position.h"
 #include "rescue_operation.h"
+
+#include <QDateTime>
 class RescueMap;
 class QString;
 
@@ -31,7 +33,8 @@ class QString;
  * Class for status line operation in the map file. It stores:
  * - the current position being tried in the input file;
  * - the current operation being tried in the input file;
- * - the current pass (since ddrescue version ?.?.?).
+ * - the current pass (since ddrescue version ?.?.?);
+ * - the start and current times of the rescue, from the comment header (local time).
  * cf. https://www.gnu.org/software/ddrescue/manual/ddrescue_manual.html#Mapfile-structure
  */
 class RescueStatus
@@ -45,11 +48,17 @@ public:
     void setCurrentOperation(QString operation);
     int currentPass() const { return m_current_pass; }
     bool setCurrentPass(int pass);
+    QDateTime startTime() const { return m_start_time; }
+    void setStartTime(const QDateTime &time) { m_start_time = time; }
+    QDateTime currentTime() const { return m_current_time; }
+    void setCurrentTime(const QDateTime &time) { m_current_time = time; }
 
 private:
     BlockPosition m_current_position;
     RescueOperation m_current_operation;
     int m_current_pass;
+    QDateTime m_start_time;    // invalid when the mapfile has no such comment
+    QDateTime m_current_time;
 };
 
 #endif // RESCUE_STATUS_H
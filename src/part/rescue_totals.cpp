@@ -20,40 +20,44 @@
  */
 
 #include "rescue_totals.h"
+#include "rescue_map.h"
+#include "block_table.h"
 #include "block_size.h"
 #include "block_status.h"
 #include <QDebug>
 
 
 RescueTotals::RescueTotals(const RescueMap* map)
-    :RescueTotals()
+    :RescueTotals(map->totals())
 {
-    for(int line = 0; line < map->m_sizes.count(); ++line) {
-        add(map->m_sizes.at(line), map->m_statuses.at(line));
-    }
 };
 
+RescueTotals::RescueTotals(const BlockTable &blocks)
+{
+    reset();
+    const qint64 *starts = blocks.starts();
+    const quint8 *statuses = blocks.statuses();
+    for (int i = 0; i < blocks.count(); ++i) {
+        m_bytes[statuses[i]] += starts[i + 1] - starts[i];
+    }
+}
+
 void RescueTotals::reset()
 {
-    m_nontried = 0;
-    m_nontrimmed = 0;
-    m_nonscraped = 0;
-    m_badsectors = 0;
-    m_recovered = 0;
-    m_unknown = 0;
+    for (int status = 0; status < BlockStatus::code_count; ++status) {
+        m_bytes[status] = 0;
+    }
 }
 
-void RescueTotals::add(BlockSize size, BlockStatus status)
+quint8 RescueTotals::mask() const
 {
-    char status_char = status.data().at(0).toLatin1();
-    switch(status_char) {
-        case '?': m_nontried += size; break;
-        case '*': m_nontrimmed += size; break;
-        case '/': m_nonscraped += size; break;
-        case '-': m_badsectors += size; break;
-        case '+': m_recovered += size; break;
-        default: m_unknown += size;
+    quint8 result = 0;
+    for (int status = 0; status < BlockStatus::code_count; ++status) {
+        if (m_bytes[status]) {
+            result |= 1 << status;
+        }
     }
+    return result;
 }
 
 /*
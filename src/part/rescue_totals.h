@@ -22,10 +22,10 @@
 #ifndef RESCUE_TOTALS_H
 #define RESCUE_TOTALS_H
 
-#include "rescue_map.h"
 #include "block_size.h"
 #include "block_status.h"
 
+class BlockTable;
 class RescueMap;
 
 /**
@@ -35,27 +35,26 @@ class RescueMap;
 class RescueTotals
 {
 public:
-    RescueTotals(): m_nontried(0), m_nontrimmed(0), m_nonscraped(0), m_badsectors(0), m_recovered(0), m_unknown(0) {}
+    RescueTotals() { reset(); }
     RescueTotals(const RescueMap* map);
+    explicit RescueTotals(const BlockTable &blocks);  // in one pass, without any index
     
     void reset();
-    BlockSize nontried() const { return m_nontried; }
-    BlockSize nontrimmed() const { return m_nontrimmed; }
-    BlockSize nonscraped() const { return m_nonscraped; }
-    BlockSize badsectors() const { return m_badsectors; }
-    BlockSize recovered() const { return m_recovered; }
-    BlockSize unknown() const { return m_unknown; }
-    void add(BlockSize size, BlockStatus status);
+    BlockSize nontried() const { return m_bytes[BlockStatus::NonTried]; }
+    BlockSize nontrimmed() const { return m_bytes[BlockStatus::NonTrimmed]; }
+    BlockSize nonscraped() const { return m_bytes[BlockStatus::NonScraped]; }
+    BlockSize badsectors() const { return m_bytes[BlockStatus::BadSector]; }
+    BlockSize recovered() const { return m_bytes[BlockStatus::Recovered]; }
+    BlockSize unknown() const { return m_bytes[BlockStatus::Unknown]; }
+    BlockSize total(BlockStatus::Code status) const { return m_bytes[status]; }
+    quint8 mask() const;  // bit (1 << status code) set for each status present
+    void add(BlockSize size, BlockStatus status) { add(size.data(), status.code()); }
+    void add(qint64 size, BlockStatus::Code status) { m_bytes[status] += size; }
 
     // QList<QPair<String, qreal>> totals() const; // for Pie chart
 
 private:
-    BlockSize m_nontried;
-    BlockSize m_nontrimmed;
-    BlockSize m_nonscraped;
-    BlockSize m_badsectors;
-    BlockSize m_recovered;
-    BlockSize m_unknown;
+    qint64 m_bytes[BlockStatus::code_count];  // indexed by status code
 };
 
 QDebug operator<<(QDebug dbg, const RescueTotals &t);
@@ -39,19 +39,25 @@ SquareColor::~SquareColor()
 }
 
 SquareColor::SquareColor(const RescueTotals &totals)
+    :SquareColor(totals.mask())
+{
+}
+
+SquareColor::SquareColor(quint8 status_mask)
     :SquareColor()
 {
-    const int nontried = totals.nontried().data() ? 1 : 0;
-    const int nontrimmed = totals.nontrimmed().data() ? 4 : 0;
-    const int nonscraped = totals.nonscraped().data() ? 10 : 0;
-    const int badsectors = totals.badsectors().data() ? 40 : 0;
-    const int recovered = totals.recovered().data() ? 2 : 0;
-    const int unknown = totals.unknown().data() ? 127 : 255;
+    const int nontried = status_mask & (1 << BlockStatus::NonTried) ? 1 : 0;
+    const int nontrimmed = status_mask & (1 << BlockStatus::NonTrimmed) ? 4 : 0;
+    const int nonscraped = status_mask & (1 << BlockStatus::NonScraped) ? 10 : 0;
+    const int badsectors = status_mask & (1 << BlockStatus::BadSector) ? 40 : 0;
+    const int recovered = status_mask & (1 << BlockStatus::Recovered) ? 2 : 0;
+    const int unknown = status_mask & (1 << BlockStatus::Unknown) ? 127 : 255;
     
     const int color_count = nontried + nontrimmed + nonscraped + badsectors + recovered ;
     
     if (!color_count) {
         this->setRgb(211, 211, 211, 255);  // default to fully transparent (lightgray)
+        return;
     }
     
     int red =  ( nontried * 0x40 +
@@ -41,6 +41,7 @@ public:
     ~SquareColor();
 
     SquareColor(const RescueTotals &totals);
+    explicit SquareColor(quint8 status_mask);  // statuses present, as in RescueTotals::mask()
 };
 
 Q_DECLARE_METATYPE(SquareColor);
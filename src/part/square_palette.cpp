@@ -0,0 +1,217 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "square_palette.h"
+#include "square_color.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SQUARE_PALETTE_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/* the palette, and the same palette split into one table of 64 bytes per channel
+ * for the byte shuffles, in memory order of a QRgb: blue, green, red, alpha */
+struct Palette
+{
+    Palette()
+    {
+        for (int mask = 0; mask < SquarePalette::mask_count; ++mask) {
+            const QRgb rgb = SquareColor(quint8(mask)).rgba();
+            pixels[mask] = rgb;
+            channels[0][mask] = quint8(qBlue(rgb));
+            channels[1][mask] = quint8(qGreen(rgb));
+            channels[2][mask] = quint8(qRed(rgb));
+            channels[3][mask] = quint8(qAlpha(rgb));
+        }
+    }
+
+    QRgb pixels[SquarePalette::mask_count];
+    alignas(16) quint8 channels[4][SquarePalette::mask_count];
+};
+
+const Palette &palette()
+{
+    static const Palette instance;
+    return instance;
+}
+
+void toPixelsScalar(const quint8 *masks, QRgb *pixels, int count)
+{
+    const QRgb *lookup = palette().pixels;
+    for (int i = 0; i < count; ++i) {
+        pixels[i] = lookup[masks[i] & (SquarePalette::mask_count - 1)];
+    }
+}
+
+#ifdef SQUARE_PALETTE_X86
+
+/*
+ * A 64-entry byte lookup from four 16-entry shuffles: the low 4 bits of each index
+ * select in each table, bits 4 and 5 select the table.
+ */
+__attribute__((target("sse4.1")))
+inline __m128i lookup64(const __m128i tables[4], __m128i index, __m128i bit4, __m128i bit5)
+{
+    const __m128i low = _mm_blendv_epi8(_mm_shuffle_epi8(tables[0], index), _mm_shuffle_epi8(tables[1], index), bit4);
+    const __m128i high = _mm_blendv_epi8(_mm_shuffle_epi8(tables[2], index), _mm_shuffle_epi8(tables[3], index), bit4);
+    return _mm_blendv_epi8(low, high, bit5);
+}
+
+__attribute__((target("sse4.1")))
+int toPixelsSse41(const quint8 *masks, QRgb *pixels, int count)
+{
+    __m128i tables[4][4];
+    for (int channel = 0; channel < 4; ++channel) {
+        for (int table = 0; table < 4; ++table) {
+            tables[channel][table] = _mm_load_si128(reinterpret_cast<const __m128i*>(palette().channels[channel] + 16 * table));
+        }
+    }
+    const __m128i index_mask = _mm_set1_epi8(SquarePalette::mask_count - 1);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i index = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(masks + i)), index_mask);
+        const __m128i bit4 = _mm_slli_epi16(index, 3);  // blendv selects on bit 7 of each byte
+        const __m128i bit5 = _mm_slli_epi16(index, 2);
+        const __m128i blue = lookup64(tables[0], index, bit4, bit5);
+        const __m128i green = lookup64(tables[1], index, bit4, bit5);
+        const __m128i red = lookup64(tables[2], index, bit4, bit5);
+        const __m128i alpha = lookup64(tables[3], index, bit4, bit5);
+
+        /* interleave the channels into 16 pixels */
+        const __m128i blue_green_low = _mm_unpacklo_epi8(blue, green);
+        const __m128i blue_green_high = _mm_unpackhi_epi8(blue, green);
+        const __m128i red_alpha_low = _mm_unpacklo_epi8(red, alpha);
+        const __m128i red_alpha_high = _mm_unpackhi_epi8(red, alpha);
+        __m128i *out = reinterpret_cast<__m128i*>(pixels + i);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(blue_green_low, red_alpha_low));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(blue_green_low, red_alpha_low));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(blue_green_high, red_alpha_high));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(blue_green_high, red_alpha_high));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+inline __m256i lookup64(const __m256i tables[4], __m256i index, __m256i bit4, __m256i bit5)
+{
+    const __m256i low = _mm256_blendv_epi8(_mm256_shuffle_epi8(tables[0], index), _mm256_shuffle_epi8(tables[1], index), bit4);
+    const __m256i high = _mm256_blendv_epi8(_mm256_shuffle_epi8(tables[2], index), _mm256_shuffle_epi8(tables[3], index), bit4);
+    return _mm256_blendv_epi8(low, high, bit5);
+}
+
+__attribute__((target("avx2")))
+int toPixelsAvx2(const quint8 *masks, QRgb *pixels, int count)
+{
+    /* the shuffles work within each 128-bit lane: both lanes hold the same tables */
+    __m256i tables[4][4];
+    for (int channel = 0; channel < 4; ++channel) {
+        for (int table = 0; table < 4; ++table) {
+            tables[channel][table] = _mm256_broadcastsi128_si256(
+                _mm_load_si128(reinterpret_cast<const __m128i*>(palette().channels[channel] + 16 * table)));
+        }
+    }
+    const __m256i index_mask = _mm256_set1_epi8(SquarePalette::mask_count - 1);
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        const __m256i index = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(masks + i)), index_mask);
+        const __m256i bit4 = _mm256_slli_epi16(index, 3);
+        const __m256i bit5 = _mm256_slli_epi16(index, 2);
+        const __m256i blue = lookup64(tables[0], index, bit4, bit5);
+        const __m256i green = lookup64(tables[1], index, bit4, bit5);
+        const __m256i red = lookup64(tables[2], index, bit4, bit5);
+        const __m256i alpha = lookup64(tables[3], index, bit4, bit5);
+
+        /* the unpacks work within each lane too: lane 0 gets pixels 0-15, lane 1 pixels 16-31 */
+        const __m256i blue_green_low = _mm256_unpacklo_epi8(blue, green);
+        const __m256i blue_green_high = _mm256_unpackhi_epi8(blue, green);
+        const __m256i red_alpha_low = _mm256_unpacklo_epi8(red, alpha);
+        const __m256i red_alpha_high = _mm256_unpackhi_epi8(red, alpha);
+        const __m256i pixels_0_16 = _mm256_unpacklo_epi16(blue_green_low, red_alpha_low);    // pixels 0-3 and 16-19
+        const __m256i pixels_4_20 = _mm256_unpackhi_epi16(blue_green_low, red_alpha_low);    // pixels 4-7 and 20-23
+        const __m256i pixels_8_24 = _mm256_unpacklo_epi16(blue_green_high, red_alpha_high);  // pixels 8-11 and 24-27
+        const __m256i pixels_12_28 = _mm256_unpackhi_epi16(blue_green_high, red_alpha_high); // pixels 12-15 and 28-31
+        __m256i *out = reinterpret_cast<__m256i*>(pixels + i);
+        _mm256_storeu_si256(out, _mm256_permute2x128_si256(pixels_0_16, pixels_4_20, 0x20));
+        _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(pixels_8_24, pixels_12_28, 0x20));
+        _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(pixels_0_16, pixels_4_20, 0x31));
+        _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(pixels_8_24, pixels_12_28, 0x31));
+    }
+    return i;
+}
+
+#endif // SQUARE_PALETTE_X86
+
+}
+
+QRgb SquarePalette::pixel(quint8 status_mask)
+{
+    return palette().pixels[status_mask & (mask_count - 1)];
+}
+
+void SquarePalette::toPixels(const quint8 *status_masks, QRgb *pixels, int count)
+{
+    static const Kernel kernel = bestKernel();
+    toPixels(status_masks, pixels, count, kernel);
+}
+
+/*
+ * The kernel must be supported by the processor
+ */
+void SquarePalette::toPixels(const quint8 *status_masks, QRgb *pixels, int count, Kernel kernel)
+{
+    int done = 0;
+#ifdef SQUARE_PALETTE_X86
+    if (kernel == Avx2) {
+        done = toPixelsAvx2(status_masks, pixels, count);
+    } else if (kernel == Sse41) {
+        done = toPixelsSse41(status_masks, pixels, count);
+    }
+#else
+    Q_UNUSED(kernel);
+#endif
+    /* the squares left over by the vector loops */
+    toPixelsScalar(status_masks + done, pixels + done, count - done);
+}
+
+bool SquarePalette::isSupported(Kernel kernel)
+{
+    switch (kernel) {
+    case Scalar:
+        return true;
+#ifdef SQUARE_PALETTE_X86
+    case Sse41:
+        return __builtin_cpu_supports("sse4.1");
+    case Avx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+SquarePalette::Kernel SquarePalette::bestKernel()
+{
+    return isSupported(Avx2) ? Avx2 : isSupported(Sse41) ? Sse41 : Scalar;
+}
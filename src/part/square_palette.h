@@ -0,0 +1,50 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SQUARE_PALETTE_H
+#define SQUARE_PALETTE_H
+
+#include <QRgb>
+
+/**
+ * Colors of the squares of the grid view, from the mask of the statuses present in
+ * each square (bit 1 << BlockStatus::Code, as in RescueTotals::mask()).
+ *
+ * The palette is a lookup table of the 64 masks built from SquareColor, so both give
+ * the same pixels. toPixels() converts a whole grid at once, 16 or 32 squares at a time
+ * with SSE4.1 or AVX2 when the processor has them.
+ */
+class SquarePalette
+{
+public:
+    // the loops of toPixels(), for the tests and the benchmark
+    enum Kernel { Scalar, Sse41, Avx2 };
+
+    static QRgb pixel(quint8 status_mask);
+    static void toPixels(const quint8 *status_masks, QRgb *pixels, int count);  // with bestKernel()
+    static void toPixels(const quint8 *status_masks, QRgb *pixels, int count, Kernel kernel);
+    static bool isSupported(Kernel kernel);
+    static Kernel bestKernel();
+
+    static const int mask_count = 64;  // 6 statuses, including unknown
+};
+
+#endif // SQUARE_PALETTE_H
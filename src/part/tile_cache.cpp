@@ -0,0 +1,145 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tile_cache.h"
+#include "rescue_map_painter.h"
+
+#include <QPainter>
+#include <QSet>
+
+TileCache::TileCache()
+    : m_tiles(64 * 1024)  // 64 MiB of tiles, about 500 tiles of 8 px squares
+{
+}
+
+quint64 TileCache::key(int square_size, const QPoint &tile)  /* static method */
+{
+    return (quint64(quint16(square_size)) << 48) | (quint64(quint16(tile.x())) << 32) | quint32(tile.y());
+}
+
+/*
+ * Rows of the window missing from a cached tile are rendered into it when they
+ * follow the rows already rendered, e.g. while scrolling; the whole tile otherwise.
+ */
+QPixmap TileCache::tile(const RescueMapPainter &painter, const QPoint &tile, qint64 first_row)
+{
+    const int square_size = painter.squareSize();
+    const qint64 tile_row = qint64(tile.y()) * tile_squares;
+    const qint64 first = qMax(tile_row, first_row);
+    const qint64 last = qMin(tile_row + tile_squares, first_row + painter.size().height() / square_size) - 1;
+    const QRect rect = tileRect(tile, square_size, first_row);
+    const quint64 tile_key = key(square_size, tile);
+
+    Tile *cached = m_tiles.object(tile_key);
+    if (cached && (last < first || (cached->first_row <= first && last <= cached->last_row))) {
+        return cached->pixmap;
+    }
+    if (cached && cached->first_row <= cached->last_row
+            && first <= cached->last_row + 1 && cached->first_row - 1 <= last) {
+        if (first < cached->first_row) {
+            paintRows(painter, cached, rect, first_row, first, cached->first_row - 1);
+        }
+        if (cached->last_row < last) {
+            paintRows(painter, cached, rect, first_row, cached->last_row + 1, last);
+        }
+        cached->first_row = qMin(first, cached->first_row);
+        cached->last_row = qMax(last, cached->last_row);
+        return cached->pixmap;
+    }
+
+    Tile *rendered = new Tile{ QPixmap(rect.size()), first, last };
+    rendered->pixmap.fill(Qt::transparent);
+    if (first <= last) {
+        paintRows(painter, rendered, rect, first_row, first, last);
+    }
+    const QPixmap result = rendered->pixmap;
+    m_tiles.insert(tile_key, rendered, qMax(1, rect.width() * rect.height() * 4 / 1024));
+    return result;
+}
+
+/*
+ * Render the rows first to last of the domain into a tile at rect on the grid. The
+ * rows are cleared first: they may hold rows of the domain which changed since.
+ */
+void TileCache::paintRows(const RescueMapPainter &painter, Tile *tile, const QRect &rect,
+                          qint64 first_row, qint64 first, qint64 last)  /* static method */
+{
+    const int square_size = painter.squareSize();
+    const QRect rows(rect.left(), int(first - first_row) * square_size,
+                     rect.width(), int(last - first + 1) * square_size);
+    QPainter tile_painter(&tile->pixmap);
+    tile_painter.translate(-rect.topLeft());
+    tile_painter.setClipRect(rows);
+    tile_painter.setCompositionMode(QPainter::CompositionMode_Source);
+    tile_painter.fillRect(rows, Qt::transparent);
+    tile_painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.paint(&tile_painter, rows);
+}
+
+void TileCache::remove(const QVector<QPoint> &tiles)
+{
+    if (tiles.isEmpty()) {
+        return;
+    }
+    QSet<quint64> removed;
+    for (const QPoint &tile : tiles) {
+        removed.insert(key(0, tile));
+    }
+    const QList<quint64> keys = m_tiles.keys();
+    for (quint64 cached : keys) {
+        if (removed.contains(cached & tile_bits)) {
+            m_tiles.remove(cached);
+        }
+    }
+}
+
+/*
+ * After a refresh, dataChanged() only tells the squares of the window which changed:
+ * the rows of the tiles out of it are forgotten
+ */
+void TileCache::keepRows(qint64 first_row, qint64 last_row)
+{
+    const QList<quint64> keys = m_tiles.keys();
+    for (quint64 cached : keys) {
+        Tile *tile = m_tiles.object(cached);
+        tile->first_row = qMax(tile->first_row, first_row);
+        tile->last_row = qMin(tile->last_row, last_row);
+        if (tile->last_row < tile->first_row) {
+            m_tiles.remove(cached);
+        }
+    }
+}
+
+QRect TileCache::tiles(const QRect &rect, int square_size, qint64 first_row)  /* static method */
+{
+    const int tile_size = tile_squares * square_size;
+    const qint64 top = first_row + rect.top() / square_size;
+    const qint64 bottom = first_row + rect.bottom() / square_size;
+    return QRect(QPoint(rect.left() / tile_size, int(top / tile_squares)),
+                 QPoint(rect.right() / tile_size, int(bottom / tile_squares)));
+}
+
+QRect TileCache::tileRect(const QPoint &tile, int square_size, qint64 first_row)  /* static method */
+{
+    const int tile_size = tile_squares * square_size;
+    return QRect(tile.x() * tile_size, int((qint64(tile.y()) * tile_squares - first_row) * square_size),
+                 tile_size, tile_size);
+}
@@ -0,0 +1,81 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <QCache>
+#include <QPixmap>
+#include <QPoint>
+#include <QRect>
+#include <QVector>
+
+class RescueMapPainter;
+
+/**
+ * Cache of the grid of a map view rendered in tiles of tile_squares x tile_squares
+ * squares, keyed by square size and tile position. Scrolling and exposing only blit
+ * the cached tiles; after a refresh, only the tiles whose squares changed color are
+ * rendered again.
+ *
+ * The tile rows are counted from the first row of the domain, not of the grid: the
+ * tiles still in view when the window moves by whole rows are reused, and only the
+ * rows entering the window are rendered. A tile keeps the range of rows rendered.
+ *
+ * The cache is only valid for one grid layout and one number of bytes per square:
+ * clear it when they change.
+ */
+class TileCache
+{
+public:
+    TileCache();
+
+    // the tile, its rows of the window rendered by the painter if they are not in the
+    // cache, first_row being the row of the domain on the first row of the grid
+    QPixmap tile(const RescueMapPainter &painter, const QPoint &tile, qint64 first_row);
+    void remove(const QVector<QPoint> &tiles);  // at any square size
+    void keepRows(qint64 first_row, qint64 last_row);  // the other rows may have changed
+    void clear() { m_tiles.clear(); }
+
+    // tiles intersecting a rectangle of the grid, in pixels
+    static QRect tiles(const QRect &rect, int square_size, qint64 first_row);
+    // the tile, in pixels of the grid
+    static QRect tileRect(const QPoint &tile, int square_size, qint64 first_row);
+
+    static const int tile_squares = 64;
+
+private:
+    struct Tile
+    {
+        QPixmap pixmap;
+        qint64 first_row;  // rows of the domain rendered, none when last_row < first_row
+        qint64 last_row;
+    };
+
+    static quint64 key(int square_size, const QPoint &tile);
+    static const quint64 tile_bits = (quint64(1) << 48) - 1;  // of a key
+    static void paintRows(const RescueMapPainter &painter, Tile *tile, const QRect &rect,
+                          qint64 first_row, qint64 first, qint64 last);
+
+    QCache<quint64, Tile> m_tiles;  // cost in KiB
+};
+
+#endif // TILE_CACHE_H
@@ -0,0 +1,126 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "totals_index.h"
+
+#include <algorithm>
+
+TotalsIndex::TotalsIndex()
+{
+}
+
+void TotalsIndex::build(const BlockTable &blocks)
+{
+    m_blocks = blocks;
+    m_checkpoints.clear();
+    m_totals.reset();
+
+    const qint64 *starts = m_blocks.starts();
+    const quint8 *statuses = m_blocks.statuses();
+    qint64 bytes[BlockStatus::code_count] = {};
+    m_checkpoints.reserve((m_blocks.count() / checkpoint_interval + 1) * BlockStatus::code_count);
+    for (int block = 0; block < m_blocks.count(); ++block) {
+        if (block % checkpoint_interval == 0) {
+            for (int status = 0; status < BlockStatus::code_count; ++status) {
+                m_checkpoints.append(bytes[status]);
+            }
+        }
+        bytes[statuses[block]] += starts[block+1] - starts[block];
+    }
+    for (int status = 0; status < BlockStatus::code_count; ++status) {
+        m_totals.add(bytes[status], BlockStatus::Code(status));
+    }
+}
+
+void TotalsIndex::clear()
+{
+    m_blocks.clear();
+    m_checkpoints.clear();
+    m_totals.reset();
+}
+
+RescueTotals TotalsIndex::totals(qint64 start, qint64 finish) const
+{
+    RescueTotals result;
+    if (finish <= start) {
+        return result;
+    }
+    Cursor cursor(*this);
+    cursor.seek(start);
+    qint64 before[BlockStatus::code_count];
+    for (int status = 0; status < BlockStatus::code_count; ++status) {
+        before[status] = cursor.bytes(BlockStatus::Code(status));
+    }
+    cursor.seek(finish);
+    for (int status = 0; status < BlockStatus::code_count; ++status) {
+        result.add(cursor.bytes(BlockStatus::Code(status)) - before[status], BlockStatus::Code(status));
+    }
+    return result;
+}
+
+TotalsIndex::Cursor::Cursor(const TotalsIndex &index)
+    : m_index(index)
+    , m_block(0)
+    , m_status(BlockStatus::Unknown)
+    , m_partial(0)
+{
+    std::fill(m_bytes, m_bytes + BlockStatus::code_count, 0);
+}
+
+void TotalsIndex::Cursor::seek(qint64 position)
+{
+    const BlockTable &blocks = m_index.m_blocks;
+    const int count = blocks.count();
+    const qint64 *starts = blocks.starts();
+    const quint8 *statuses = blocks.statuses();
+    m_partial = 0;
+    if (count == 0) {
+        return;
+    }
+
+    /* the block holding the position: the last one starting at or before it */
+    int target;
+    if (position <= starts[0]) {
+        target = 0;
+        position = starts[0];
+    } else if (position >= starts[count]) {
+        target = count;
+        position = starts[count];
+    } else {
+        const qint64 *first = starts + (starts[m_block] <= position ? m_block : 0);
+        target = int(std::upper_bound(first, starts + count, position) - starts) - 1;
+    }
+
+    /* restart from the checkpoint before the target unless it is behind the cursor */
+    const int checkpoint = qMin(target, count - 1) / checkpoint_interval;
+    if (m_block > target || m_block < checkpoint * checkpoint_interval) {
+        m_block = checkpoint * checkpoint_interval;
+        const qint64 *bytes = m_index.m_checkpoints.constData() + checkpoint * BlockStatus::code_count;
+        std::copy(bytes, bytes + BlockStatus::code_count, m_bytes);
+    }
+    for (; m_block < target; ++m_block) {
+        m_bytes[statuses[m_block]] += starts[m_block+1] - starts[m_block];
+    }
+    if (m_block < count) {
+        m_status = BlockStatus::Code(statuses[m_block]);
+        m_partial = position - starts[m_block];
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ * Kddrescueview - A KPart application to visualise GNU ddrescue mapfiles
+ * Copyright 2020  Adrien Cordonnier <adrien.cordonnier@gmail.com>
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOTALS_INDEX_H
+#define TOTALS_INDEX_H
+
+#include "block_table.h"
+#include "rescue_totals.h"
+
+#include <QVector>
+
+/**
+ * Index of the cumulative byte count of each status along a map, to get the totals
+ * of any byte range without walking all its blocks.
+ *
+ * The cumulative counts are stored every checkpoint_interval blocks only, which costs
+ * less than one byte per block. A lookup is a binary search for the block holding
+ * the position, plus at most checkpoint_interval blocks added from the checkpoint
+ * before it.
+ */
+class TotalsIndex
+{
+public:
+    TotalsIndex();
+
+    void build(const BlockTable &blocks);
+    void clear();
+
+    // totals of the whole map
+    RescueTotals totals() const { return m_totals; }
+    // totals of [start, finish), clipped to the map domain
+    RescueTotals totals(qint64 start, qint64 finish) const;
+
+    /**
+     * Cumulative counts at increasing positions, e.g. at the boundaries of the squares
+     * of the grid view. Each seek starts from the previous one, so that a sweep along
+     * the map costs one lookup per boundary, not per block.
+     */
+    class Cursor
+    {
+    public:
+        Cursor(const TotalsIndex &index);
+        void seek(qint64 position);
+        qint64 bytes(BlockStatus::Code status) const { return m_bytes[status] + (status == m_status ? m_partial : 0); }
+    private:
+        const TotalsIndex &m_index;
+        int m_block;  // block holding the position, or block count after the domain
+        qint64 m_bytes[BlockStatus::code_count];  // cumulative counts at the start of m_block
+        BlockStatus::Code m_status;
+        qint64 m_partial;  // bytes of m_block before the position
+    };
+
+    static const int checkpoint_interval = 64;
+
+private:
+    BlockTable m_blocks;
+    QVector<qint64> m_checkpoints;  // code_count cumulative counts at the start of every checkpoint_interval blocks
+    RescueTotals m_totals;
+};
+
+#endif // TOTALS_INDEX_H